@@ -7,474 +7,950 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
-#include <math.h>
 #include "rv.h"
 #include "common.h"
+#include "simtime.h"
+#include "htable.h"
+#include "policy.h"
+#include "disk.h"
+#include "freelist.h"
 
 struct slot {
   int file_id;
-  unsigned int block_num;
+  int block_num;
   unsigned short dirty;
+  unsigned short writeback;   /* the flusher is writing the block out */
+  unsigned short prefetched;  /* read ahead and not yet used */
+  unsigned int seq;           /* odd while file_id/block_num change */
 };
 
+/* The number of slots, NUM_SLOTS unless set_cache_size says otherwise */
+int num_slots = NUM_SLOTS;
+
 /* The global variable holding the cache structure */
-struct slot cache[NUM_SLOTS];
+struct slot *cache;
 
-/* array of mutexes for each slot */
-pthread_mutex_t cache_locks[NUM_SLOTS];
+/* array of locks for each slot; held across disk transfers, so they
+ * are sim_locks rather than plain mutexes */
+struct sim_lock *cache_locks;
 
-struct bnode {
-  int block_num;
-  int cache_index;
-  struct bnode *next;
+/* array of conditions for each slot, broadcast when a write-back ends */
+struct sim_cond *cache_cvs;
+
+struct file_table {
+  int size;
 };
 
-typedef struct bnode bNode;
+/* The global variable holding the file table */
+struct file_table *ftable = NULL;
+int num_files = 0;
 
-/* function returns pointer to node if found, else NULL */
-bNode *bNode_search(bNode *head, int block_num){
-  if(head == NULL)
-    return NULL;
+/* replacement policy used once the cache is full */
+struct policy *cache_policy = NULL;
 
-  bNode *curr = head;
-  while(curr != NULL){
-    if(curr->block_num == block_num)
-      return curr;
+/* time to read or write a block in the cache, see set_mem_time */
+int mem_time = MEM_TIME;
 
-    curr = curr->next;
-  }
+/* take the slot lock on read hits as well, see set_locked_hits */
+int locked_hits = 0;
 
-  return NULL;
-}
+/* disk configuration, see set_disk */
+int disk_channels_cfg = 1;
+int disk_depth_cfg = 32;
+int disk_time_cfg = DISK_TIME;
 
-/* add new node to front of list and return new head */
-bNode *bNode_add(bNode *head, int block_num, int cache_index){
-  bNode *temp = malloc(sizeof (bNode));
+/* A block being fetched from disk. Other threads missing on the same
+ * block wait for this fetch instead of evicting a slot of their own.
+ * Entries live on the stack of the fetching thread.
+ */
+struct fetch {
+  int file_id;
+  int block_num;
+  int slot;           /* where the block was loaded, valid once done */
+  int done;
+  int waiters;        /* threads waiting for this fetch */
+  struct fetch *next;
+};
 
-  /* Initialize node */
-  temp->block_num = block_num;
-  temp->cache_index = cache_index;
+/* list of fetches in progress, with its mutex */
+struct fetch *fetches = NULL;
+pthread_mutex_t fetch_lock;
 
-  temp->next = head;
+/* broadcast when a fetch completes or loses its last waiter */
+struct sim_cond fetch_cv;
 
-  return temp;
-}
+/* misses that were satisfied by another thread's fetch */
+long coalesced = 0;
 
-/* remove node from list and return the head */
-bNode *bNode_remove(bNode *head, int block_num){
-  bNode *prev, *curr, *toRemove;
-  int found = 0;
+/* Background flusher, see set_flusher. It wakes when more than
+ * dirty_limit slots are dirty and writes blocks back until at most half
+ * that many are left.
+ */
+double flush_ratio_cfg = -1;
+int flush_enabled = 0;
+int dirty_limit;
+int ndirty;               /* slots currently dirty */
+int flush_stopping;
+pthread_t flusher;
+pthread_mutex_t flush_lock;
+struct sim_cond flush_cv; /* signalled when ndirty exceeds dirty_limit */
+
+/* Counts slot fills. A miss that finds every slot being refilled waits
+ * for it to change instead of spinning, so that it does not hold up the
+ * virtual clock.
+ */
+unsigned int fill_gen;
+pthread_mutex_t fill_lock;
+struct sim_cond fill_cv;
+
+/* Sequential prefetch, see set_prefetch. Each thread's accesses to a
+ * file form a stream; once a stream has made two sequential accesses,
+ * the blocks up to prefetch_depth ahead of it are queued for the
+ * prefetch threads, which load them like a miss would.
+ */
+#define STREAMS 256           /* streams tracked at once */
+#define PF_QUEUE 256          /* most prefetches queued */
+#define MAX_PREFETCHERS 8
 
-  prev = curr = head;
-  while(curr != NULL){
-    if(curr->block_num == block_num){
-      found = 1;
-      toRemove = curr;
-      break;
-    }
+struct stream {
+  int pid;                    /* owner, -1 if unused */
+  int file_id;
+  int next;                   /* block a sequential access touches next */
+  int run;                    /* sequential accesses so far */
+  int ahead;                  /* first block not yet queued */
+};
 
-    prev = curr;
-    curr = curr->next;
-  }
+int prefetch_depth = 0;
+struct stream streams[STREAMS];
+pthread_mutex_t stream_locks[STREAMS];
 
-  if(found == 0)
-    return head;
+/* ring of blocks waiting to be prefetched */
+struct pf_req {
+  int file_id;
+  int block_num;
+};
+struct pf_req pf_queue[PF_QUEUE];
+int pf_head, pf_len;
+int pf_stopping;
+pthread_mutex_t pf_lock;
+struct sim_cond pf_cv;        /* signalled when a block is queued */
 
-  if(toRemove == head)
-    head = head->next;
-  else 
-    prev->next = toRemove->next;
+int pf_nthreads;
+pthread_t pf_threads[MAX_PREFETCHERS];
+static void *prefetcher(void *arg);
 
-  free(toRemove);
-  return head;
-}
+/* blocks prefetched, used by a demand access, and evicted unused */
+long pf_issued, pf_used, pf_wasted;
 
-/* free up each node of the list and return NULL */
-bNode *bNode_free_list(bNode *head){
-  bNode *next = head;
+/* blocks dropped by invalidate_file, and fills that took a free slot */
+long invalidated = 0;
+long free_fills = 0;
 
-  while(head != NULL){
-    next = head->next;
-    free(head);
-    head = next;
-  }
+/* Set the number of cache slots; must be called before init_cache.
+ */
+void set_cache_size(int slots) {
+  num_slots = slots;
+}
 
-  return NULL;
+/* Set the time a hit spends on the block; the default is MEM_TIME.
+ */
+void set_mem_time(int msec) {
+  mem_time = msec;
 }
 
-struct file_table {
-  int size;
-  struct bnode *head;
-};
+/* Make read hits lock the slot and the index bucket like writes do,
+ * instead of validating the slot optimistically; for comparison.
+ */
+void set_locked_hits(int locked) {
+  locked_hits = locked;
+}
 
-/* The global variable holding the file table */
-struct file_table ftable[NUM_FILES];
+/* Select the replacement policy by name; must be called before
+ * init_cache. Returns 0 on success, -1 if there is no such policy.
+ */
+int set_policy(const char *name) {
+  struct policy *p = find_policy(name);
+  if(p == NULL)
+    return -1;
 
-/* array of mutexes for each file */
-pthread_mutex_t ftable_locks[NUM_FILES];
+  cache_policy = p;
+  return 0;
+}
 
-/* mutex for io request */
-pthread_mutex_t io_lock;
+/* Configure the simulated disk: number of parallel channels, most
+ * requests outstanding, and milliseconds per transfer. Must be called
+ * before init_cache; the default is one channel at DISK_TIME.
+ */
+void set_disk(int channels, int depth, int service_time) {
+  disk_channels_cfg = channels;
+  disk_depth_cfg = depth;
+  disk_time_cfg = service_time;
+}
 
-/* variable to track empty slots along with mutex */
-int slot_count = NUM_SLOTS;
-pthread_mutex_t slot_count_lock;
+/* Read up to depth blocks ahead of every sequential stream; 0 turns
+ * prefetching off (the default). Must be called before init_cache.
+ */
+void set_prefetch(int depth) {
+  prefetch_depth = depth;
+}
 
-/* return slot number if available else -1 */
-int get_empty_slot(){
-  pthread_mutex_lock(&slot_count_lock);
+/* Run a background flusher that starts writing dirty blocks back once
+ * more than ratio of the slots are dirty; a negative ratio turns it off
+ * (the default). While it runs, victims are chosen among clean slots
+ * when possible. Must be called before init_cache.
+ */
+void set_flusher(double ratio) {
+  flush_ratio_cfg = ratio;
+}
 
-  int ret_val;
-  if(slot_count > 0){
-    ret_val = NUM_SLOTS - slot_count;
-    slot_count--;
-  } else{
-    ret_val = -1;
+/* allocate a file table of nfiles files, replacing the current one */
+static void alloc_file_table(int nfiles) {
+  free(ftable);
+  ftable = malloc(nfiles * sizeof(struct file_table));
+  if(ftable == NULL){
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
   }
-
-  pthread_mutex_unlock(&slot_count_lock);
-  return ret_val;
+  num_files = nfiles;
 }
 
-/* Initialize the file table data structure with file sizes 
- * chosen from a Geometric distribution.
+/* Initialize the file table data structure with nfiles files whose
+ * sizes are chosen from a Geometric distribution.
  */
-void build_file_table() {
+void build_file_table(int nfiles) {
   int i;
   double p = 1 - (1.0 / MEAN_FILE_SIZE);
-  for(i = 0; i < NUM_FILES; i++) {
+  alloc_file_table(nfiles);
+  for(i = 0; i < nfiles; i++) {
     double k = Geometric(p);
     ftable[i].size = k + 1;  /* Files can't have size 0 */
-    ftable[i].head = NULL;
   }
 }
 
-/* free up each list in the file table */
-void destroy_file_table(){
-  for(int i=0; i<NUM_FILES; i++)
-    ftable[i].head = bNode_free_list(ftable[i].head);
+/* Initialize the file table with the given file sizes, e.g. the ones
+ * a trace touches.
+ */
+void set_file_table(const int *sizes, int nfiles) {
+  alloc_file_table(nfiles);
+  for(int i = 0; i < nfiles; i++)
+    ftable[i].size = sizes[i];
+}
+
+/* Return the number of files in the file table.
+ */
+int get_num_files() {
+  return num_files;
 }
 
 /* Return the size of the file specified by fileid.
  */
 int get_file_size(int fileid) {
-  /* Since this function doesn't access the linked list structure,
-   * no synchronization should be needed in it's logic
+  /* File sizes never change after build_file_table, so no
+   * synchronization is needed here
    */
-  if((fileid < 0) || (fileid >= NUM_FILES))
+  if((fileid < 0) || (fileid >= num_files))
     return 0;
   else
     return ftable[fileid].size;
 }
 
+/* lock-free hint for the replacement policy: is the slot clean */
+int slot_is_clean(int slot) {
+  return !__atomic_load_n(&cache[slot].dirty, __ATOMIC_RELAXED) &&
+    !__atomic_load_n(&cache[slot].writeback, __ATOMIC_RELAXED);
+}
+
+/* mark a slot dirty; call with the slot's lock held */
+static void mark_dirty(int slot) {
+  if(cache[slot].dirty)
+    return;
+  cache[slot].dirty = 1;
+
+  int n = __atomic_add_fetch(&ndirty, 1, __ATOMIC_RELAXED);
+  if(flush_enabled && (n > dirty_limit)){
+    pthread_mutex_lock(&flush_lock);
+    sim_cond_signal(&flush_cv);
+    pthread_mutex_unlock(&flush_lock);
+  }
+}
+
+/* mark a slot clean; call with the slot's lock held */
+static void mark_clean(int slot) {
+  if(!cache[slot].dirty)
+    return;
+  cache[slot].dirty = 0;
+  __atomic_sub_fetch(&ndirty, 1, __ATOMIC_RELAXED);
+}
+
+/* Body of the flusher thread: sweep the slots in order writing dirty
+ * blocks back, without holding the slot's lock during the transfer.
+ */
+static void *flush_dirty(void *arg) {
+  int cursor = 0;
+
+  pthread_mutex_lock(&flush_lock);
+  for(;;){
+    while(!flush_stopping && (__atomic_load_n(&ndirty, __ATOMIC_RELAXED) <= dirty_limit))
+      sim_cond_wait(&flush_cv, &flush_lock);
+    if(flush_stopping)
+      break;
+    pthread_mutex_unlock(&flush_lock);
+
+    int flushed = 0;
+    for(int i = 0; i < num_slots; i++){
+      if(__atomic_load_n(&ndirty, __ATOMIC_RELAXED) <= dirty_limit / 2)
+        break;
+
+      int slot = cursor;
+      cursor = (cursor + 1) % num_slots;
+
+      sim_lock_acquire(&cache_locks[slot]);
+      if(!cache[slot].dirty || cache[slot].writeback){
+        sim_lock_release(&cache_locks[slot]);
+        continue;
+      }
+      /* the block is copied out as it is now; a write while it is on
+       * its way to disk simply dirties the slot again */
+      int file_id = cache[slot].file_id;
+      int block_num = cache[slot].block_num;
+      mark_clean(slot);
+      cache[slot].writeback = 1;
+      sim_lock_release(&cache_locks[slot]);
+
+      disk_io(file_id, block_num, DISK_WRITE);
+      flushed++;
+
+      sim_lock_acquire(&cache_locks[slot]);
+      cache[slot].writeback = 0;
+      sim_lock_broadcast(&cache_cvs[slot], &cache_locks[slot]);
+      sim_lock_release(&cache_locks[slot]);
+    }
+
+    pthread_mutex_lock(&flush_lock);
+    /* nothing could be written back (every dirty slot is busy being
+     * evicted); wait for the next block to be dirtied */
+    if((flushed == 0) && !flush_stopping)
+      sim_cond_wait(&flush_cv, &flush_lock);
+  }
+  pthread_mutex_unlock(&flush_lock);
+
+  sim_thread_exit();
+
+  return NULL;
+}
+
 void init_cache() {
-  for(int i = 0; i < NUM_SLOTS; i++){
+  cache = malloc(num_slots * sizeof(struct slot));
+  cache_locks = malloc(num_slots * sizeof(struct sim_lock));
+  cache_cvs = malloc(num_slots * sizeof(struct sim_cond));
+  if((cache == NULL) || (cache_locks == NULL) || (cache_cvs == NULL)){
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+
+  for(int i = 0; i < num_slots; i++){
     /* Initialize each slot to free */
     cache[i].file_id = -1;
     cache[i].dirty = 0;
+    cache[i].writeback = 0;
+    cache[i].prefetched = 0;
+    cache[i].seq = 0;
+
+    /* Initialize lock and condition for each slot */
+    sim_lock_init(&cache_locks[i]);
+    sim_cond_init(&cache_cvs[i]);
+  }
+
+  /* Initialize the block index */
+  ht_init(num_slots);
 
-    /* Initialize mutex for each slot */
-    if(pthread_mutex_init(&cache_locks[i], NULL) != 0){
+  /* Initialize the replacement policy, random unless chosen otherwise */
+  if(cache_policy == NULL)
+    cache_policy = find_policy("random");
+  cache_policy->init(num_slots);
+
+  /* Start the disk */
+  disk_init(disk_channels_cfg, disk_depth_cfg, disk_time_cfg);
+
+  /* Initialize the list of fetches in progress */
+  fetches = NULL;
+  coalesced = 0;
+  if(pthread_mutex_init(&fetch_lock, NULL) != 0){
+    fprintf(stderr, "Error Initializing Mutex\n");
+    exit(1);
+  }
+  sim_cond_init(&fetch_cv);
+
+  /* Start the flusher if wanted */
+  ndirty = 0;
+  flush_stopping = 0;
+  flush_enabled = flush_ratio_cfg >= 0;
+  prefer_clean = flush_enabled;
+  if(flush_enabled){
+    dirty_limit = flush_ratio_cfg * num_slots;
+    if(pthread_mutex_init(&flush_lock, NULL) != 0){
       fprintf(stderr, "Error Initializing Mutex\n");
       exit(1);
     }
+    sim_cond_init(&flush_cv);
+    sim_thread_add(1);
+    if(pthread_create(&flusher, NULL, flush_dirty, NULL) != 0){
+      fprintf(stderr, "Error creating thread\n");
+      exit(1);
+    }
   }
 
-  /* Initialize mutex for each file */
-  for(int i = 0; i < NUM_FILES; i++){
-    if(pthread_mutex_init(&ftable_locks[i], NULL) != 0){
+  /* Start the prefetch threads if wanted, one per disk channel */
+  pf_issued = pf_used = pf_wasted = 0;
+  pf_nthreads = 0;
+  if(prefetch_depth > 0){
+    for(int i = 0; i < STREAMS; i++){
+      streams[i].pid = -1;
+      if(pthread_mutex_init(&stream_locks[i], NULL) != 0){
+        fprintf(stderr, "Error Initializing Mutex\n");
+        exit(1);
+      }
+    }
+
+    pf_head = pf_len = 0;
+    pf_stopping = 0;
+    if(pthread_mutex_init(&pf_lock, NULL) != 0){
       fprintf(stderr, "Error Initializing Mutex\n");
       exit(1);
     }
+    sim_cond_init(&pf_cv);
+
+    pf_nthreads = disk_channels_cfg < MAX_PREFETCHERS ?
+      disk_channels_cfg : MAX_PREFETCHERS;
+    sim_thread_add(pf_nthreads);
+    for(int i = 0; i < pf_nthreads; i++){
+      if(pthread_create(&pf_threads[i], NULL, prefetcher, (void *)(long)i) != 0){
+        fprintf(stderr, "Error creating thread\n");
+        exit(1);
+      }
+    }
   }
 
-  /* Initialize io lock */
-  if(pthread_mutex_init(&io_lock, NULL) != 0){
+  /* every slot starts out empty */
+  fl_init(num_slots);
+  invalidated = free_fills = 0;
+
+  /* Initialize the fill counter */
+  fill_gen = 0;
+  if(pthread_mutex_init(&fill_lock, NULL) != 0){
     fprintf(stderr, "Error Initializing Mutex\n");
     exit(1);
   }
+  sim_cond_init(&fill_cv);
+}
 
-  /* Initialize slot_count lock */
-  if(pthread_mutex_init(&slot_count_lock, NULL) != 0){
-    fprintf(stderr, "Error Initializing Mutex\n");
-    exit(1);
+/* release everything set up by init_cache */
+void destroy_cache() {
+  if(flush_enabled){
+    pthread_mutex_lock(&flush_lock);
+    flush_stopping = 1;
+    sim_cond_signal(&flush_cv);
+    pthread_mutex_unlock(&flush_lock);
+
+    pthread_join(flusher, NULL);
+    pthread_mutex_destroy(&flush_lock);
+    sim_cond_destroy(&flush_cv);
   }
+
+  if(pf_nthreads > 0){
+    /* blocks still queued are not worth reading any more */
+    pthread_mutex_lock(&pf_lock);
+    pf_stopping = 1;
+    sim_cond_broadcast(&pf_cv);
+    pthread_mutex_unlock(&pf_lock);
+
+    for(int i = 0; i < pf_nthreads; i++)
+      pthread_join(pf_threads[i], NULL);
+    pthread_mutex_destroy(&pf_lock);
+    sim_cond_destroy(&pf_cv);
+    for(int i = 0; i < STREAMS; i++)
+      pthread_mutex_destroy(&stream_locks[i]);
+  }
+
+  for(int i = 0; i < num_slots; i++){
+    sim_lock_destroy(&cache_locks[i]);
+    sim_cond_destroy(&cache_cvs[i]);
+  }
+  free(cache);
+  free(cache_locks);
+  free(cache_cvs);
+
+  ht_destroy();
+  disk_shutdown();
+  pthread_mutex_destroy(&fetch_lock);
+  sim_cond_destroy(&fetch_cv);
+  fl_destroy();
+  pthread_mutex_destroy(&fill_lock);
+  sim_cond_destroy(&fill_cv);
 }
 
-/* create timespec with a given number of milliseconds */
-void sleep_timespec(struct timespec *sleep_time, int msec){
-  /* convert milli seconds to nano seconds */
-  unsigned long int nsec = msec*1000*1000;
-  /* tv_nsec cannot be greater than 999999999, thus need
-   * to use seconds fields if extra time needed */
-  if(nsec >= 1000000000){
-    /* floor to nearest second, put rest in nanosec */
-    sleep_time->tv_sec = floor(nsec/1000000000.0);
-    sleep_time->tv_nsec = nsec - (sleep_time->tv_sec * 1000000000);
-  } else {
-    sleep_time->tv_sec = 0;
-    sleep_time->tv_nsec = nsec;
+/* Report disk transfers and misses that shared another thread's fetch.
+ * Call before destroy_cache.
+ */
+void cache_io_stats(long *reads, long *writes, long *shared) {
+  disk_stats(reads, writes);
+
+  *shared = __atomic_load_n(&coalesced, __ATOMIC_RELAXED);
+}
+
+/* Report blocks prefetched, how many of them a demand access used, how
+ * many were evicted unused, and how many are still cached unused. Call
+ * after the workload has finished and before destroy_cache.
+ */
+void cache_prefetch_stats(long *issued, long *used, long *wasted, long *unused) {
+  *issued = __atomic_load_n(&pf_issued, __ATOMIC_RELAXED);
+  *used = __atomic_load_n(&pf_used, __ATOMIC_RELAXED);
+  *wasted = __atomic_load_n(&pf_wasted, __ATOMIC_RELAXED);
+
+  *unused = 0;
+  for(int i = 0; i < num_slots; i++){
+    if(__atomic_load_n(&cache[i].prefetched, __ATOMIC_RELAXED))
+      (*unused)++;
   }
 }
 
-/* evict a block from the cache, writing it to disk first if dirty */
-void evict_block(int slot){
-  int file_id = cache[slot].file_id;
-  int block_num = cache[slot].block_num;
+/* Report blocks dropped by invalidate_file and misses that filled a
+ * free slot rather than evicting a block.
+ */
+void cache_free_stats(long *dropped, long *reused) {
+  *dropped = __atomic_load_n(&invalidated, __ATOMIC_RELAXED);
+  *reused = __atomic_load_n(&free_fills, __ATOMIC_RELAXED);
+}
 
-  if(cache[slot].dirty == 1){
-    /* copy block from cache to disk
-     * i.e. sleep for DISK_TIME */
-    struct timespec sleep_time;
-    sleep_timespec(&sleep_time, DISK_TIME);
+/* Change the block slot holds; call with the slot's lock held. seq is
+ * odd while the change is in progress, so a lock-free reader that saw
+ * the slot before or during it will notice and retry.
+ */
+static void slot_set(int slot, int file_id, int block_num) {
+  __atomic_store_n(&cache[slot].seq, cache[slot].seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&cache[slot].file_id, file_id, __ATOMIC_RELAXED);
+  __atomic_store_n(&cache[slot].block_num, block_num, __ATOMIC_RELAXED);
+  __atomic_store_n(&cache[slot].seq, cache[slot].seq + 1, __ATOMIC_RELEASE);
+}
 
-    /* Only one thread can access disk at a time */
-    pthread_mutex_lock(&io_lock);
-    nanosleep(&sleep_time, NULL);
-    pthread_mutex_unlock(&io_lock);
+/* evict a block from the cache, writing it to disk first if dirty
+ * unless it is being discarded */
+void evict_block(int slot, int discard){
+  /* the slot cannot be reused while the flusher is still writing it */
+  while(cache[slot].writeback)
+    sim_lock_wait(&cache_cvs[slot], &cache_locks[slot]);
 
+  if(cache[slot].dirty == 1){
     /* Now mark slot as non-dirty */
-    cache[slot].dirty = 0;
+    mark_clean(slot);
+
+    /* copy block from cache to disk */
+    if(!discard)
+      disk_io(cache[slot].file_id, cache[slot].block_num, DISK_WRITE);
   } 
 
-  /* remove block from owning file's list */
-  pthread_mutex_lock(&ftable_locks[file_id]);
-  ftable[file_id].head = bNode_remove(ftable[file_id].head, block_num);
-  pthread_mutex_unlock(&ftable_locks[file_id]);
+  /* a prefetched block leaving unused was read for nothing */
+  if(__atomic_exchange_n(&cache[slot].prefetched, 0, __ATOMIC_RELAXED))
+    __atomic_add_fetch(&pf_wasted, 1, __ATOMIC_RELAXED);
+
+  /* remove block from the index */
+  ht_remove(slot);
 
   /* mark slot as free */
-  cache[slot].file_id = -1;
+  slot_set(slot, -1, 0);
 }
 
-/* Simulates the read operation for the block block_num of file file_id, 
- * for the thread pid.
- * Returns 0 if the block was needed to be fetched from the disk, 
- *         1 if the block was found in the cache
- *         2 if the requested block was invalid
+/* a demand access has used the block in slot; count it if prefetched */
+static void prefetch_used(int slot) {
+  if(__atomic_load_n(&cache[slot].prefetched, __ATOMIC_RELAXED) &&
+      __atomic_exchange_n(&cache[slot].prefetched, 0, __ATOMIC_RELAXED))
+    __atomic_add_fetch(&pf_used, 1, __ATOMIC_RELAXED);
+}
+
+/* Access the block if it is still in slot. Returns 1 on success, 0 if
+ * the slot was re-written since it was looked up.
  */
-int read_block(int pid, int file_id, int block_num) {
-  /* check if file_id is valid */
-  if((file_id < 0) || (file_id >= NUM_FILES)){
-    return 2;
-  }
+static int use_slot(int slot, int file_id, int block_num, int write) {
+  sim_lock_acquire(&cache_locks[slot]);
 
-  pthread_mutex_lock(&ftable_locks[file_id]);
-  bNode *node = NULL;
-  int found = 0;
-  
-  /* check if invalid request */
-  if((block_num < 0) || (block_num >= get_file_size(file_id))){
-    pthread_mutex_unlock(&ftable_locks[file_id]);
+  /* check if slot hasn't been re-written since the lookup */
+  if((cache[slot].file_id != file_id) || (cache[slot].block_num != block_num)){
+#ifdef DEBUG
+    printf("file %d, block %d, slot %d, slot overwritten\n", file_id, block_num, slot);
+#endif
+    sim_lock_release(&cache_locks[slot]);
+    return 0;
+  }
 
-    return 2;
-  } else if((node = bNode_search(ftable[file_id].head, block_num)) != NULL){
-    int slot = node->cache_index;
-    /* if block found in cache */
-    found = 1;
-    pthread_mutex_unlock(&ftable_locks[file_id]);
-
-    pthread_mutex_lock(&cache_locks[slot]);
-    /* check if slot hasn't been re-written */
-    if((cache[slot].file_id == file_id) && (cache[slot].block_num == block_num)){
 #ifdef DEBUG
-      printf("file %d, block %d, slot %d, read from cache\n", file_id, block_num, slot);
+  printf("file %d, block %d, slot %d, %s cache\n", file_id, block_num, slot,
+      write ? "write to" : "read from");
 #endif
-      /* sleep for MEM_TIME */
-      struct timespec sleep_time;
-      sleep_timespec(&sleep_time, MEM_TIME);
+  /* sleep for MEM_TIME */
+  sim_sleep(mem_time);
 
-      nanosleep(&sleep_time, NULL);
+  if(write)
+    mark_dirty(slot);
+
+  prefetch_used(slot);
+  cache_policy->hit(slot);
+
+  sim_lock_release(&cache_locks[slot]);
+  return 1;
+}
+
+/* Read the block if it is still in slot, without taking any lock: the
+ * slot's seq is read before and after the read, and the read only
+ * counts if no change to the slot overlapped it. Returns 1 on success,
+ * 0 if the slot did not hold the block or was changed meanwhile.
+ */
+static int read_slot(int slot, int file_id, int block_num) {
+  unsigned int seq = __atomic_load_n(&cache[slot].seq, __ATOMIC_ACQUIRE);
+  if((seq & 1) ||
+      (__atomic_load_n(&cache[slot].file_id, __ATOMIC_RELAXED) != file_id) ||
+      (__atomic_load_n(&cache[slot].block_num, __ATOMIC_RELAXED) != block_num))
+    return 0;
 
-      pthread_mutex_unlock(&cache_locks[slot]);
-      return 1;
-    } else {
 #ifdef DEBUG
-      printf("file %d, block %d, slot %d, slot overwritten\n", file_id, block_num, slot);
+  printf("file %d, block %d, slot %d, read from cache\n", file_id, block_num, slot);
 #endif
-      pthread_mutex_unlock(&cache_locks[slot]);
-    }
-  }
+  /* sleep for MEM_TIME */
+  sim_sleep(mem_time);
 
-  /* if block was found then file has already been unlocked */
-  if(found == 0){
-    /* unlock file since we're not going to modify it until
-     * we've copied the block over to the cache */
-    pthread_mutex_unlock(&ftable_locks[file_id]);
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if(__atomic_load_n(&cache[slot].seq, __ATOMIC_RELAXED) != seq){
+#ifdef DEBUG
+    printf("file %d, block %d, slot %d, slot overwritten\n", file_id, block_num, slot);
+#endif
+    return 0;
   }
 
-  /* get empty slot if available else randomly select one */
-  int slot = get_empty_slot();
-  if(slot == -1){
-    slot = Equilikely(0, NUM_SLOTS-1);
+  prefetch_used(slot);
+  cache_policy->hit(slot);
+  return 1;
+}
+
+/* Access the block in slot the way hits are configured to: writes (and
+ * all hits with locked_hits) lock the slot, reads validate it. */
+static int hit_slot(int slot, int file_id, int block_num, int write) {
+  if(write || locked_hits)
+    return use_slot(slot, file_id, block_num, write);
+  return read_slot(slot, file_id, block_num);
+}
+
+/* a slot has become a candidate for the next miss again */
+static void slot_available() {
+  pthread_mutex_lock(&fill_lock);
+  fill_gen++;
+  sim_cond_broadcast(&fill_cv);
+  pthread_mutex_unlock(&fill_lock);
+}
+
+/* Bring a block into the cache and return the slot it was loaded into;
+ * prefetch is 1 when no one has asked for the block yet.
+ */
+static int load_block(int pid, int file_id, int block_num, int write, int prefetch) {
+  /* get empty slot if available else ask the policy for a victim; it
+   * only fails while every slot is being refilled by another thread */
+  int slot;
+  for(;;){
+    pthread_mutex_lock(&fill_lock);
+    unsigned int gen = fill_gen;
+    pthread_mutex_unlock(&fill_lock);
+
+    if((slot = fl_get(pid)) != -1){
+      __atomic_add_fetch(&free_fills, 1, __ATOMIC_RELAXED);
+      break;
+    }
+    if((slot = cache_policy->victim(file_id, block_num)) != -1)
+      break;
+
+    pthread_mutex_lock(&fill_lock);
+    while(fill_gen == gen)
+      sim_cond_wait(&fill_cv, &fill_lock);
+    pthread_mutex_unlock(&fill_lock);
   }
 
 #ifdef DEBUG
-  printf("file %d, block %d, slot %d, read from disk\n", file_id, block_num, slot);
+  printf("file %d, block %d, slot %d, %s from disk\n", file_id, block_num, slot,
+      write ? "write" : "read");
 #endif
-  pthread_mutex_lock(&cache_locks[slot]);
+  sim_lock_acquire(&cache_locks[slot]);
 
   /* if block not empty, evict it */
   if(cache[slot].file_id != -1){
-    evict_block(slot);
+    evict_block(slot, 0);
   }
 
-  /* copy block from disk to cache
-   * i.e. sleep for DISK_TIME */
-  struct timespec sleep_time;
-  sleep_timespec(&sleep_time, DISK_TIME);
-
-  /* only one thread can access disk at a time */
-  pthread_mutex_lock(&io_lock);
-  nanosleep(&sleep_time, NULL);
-  pthread_mutex_unlock(&io_lock);
+  /* copy block from disk to cache */
+  disk_io(file_id, block_num, DISK_READ);
 
   /* update the slot with block info */
-  cache[slot].file_id = file_id;
-  cache[slot].block_num = block_num;
+  slot_set(slot, file_id, block_num);
   cache[slot].dirty = 0;
+  if(write)
+    mark_dirty(slot);
+  __atomic_store_n(&cache[slot].prefetched, prefetch, __ATOMIC_RELAXED);
 
-  /* now add the block info to file list */
-  pthread_mutex_lock(&ftable_locks[file_id]);
-  ftable[file_id].head = bNode_add(ftable[file_id].head, block_num, slot);
-  pthread_mutex_unlock(&ftable_locks[file_id]);
+  /* now make the block visible to lookups */
+  ht_insert(file_id, block_num, slot);
+  cache_policy->fill(slot, file_id, block_num);
 
-  pthread_mutex_unlock(&cache_locks[slot]);
+  sim_lock_release(&cache_locks[slot]);
 
-  return 0;
+  /* the slot is a candidate victim again */
+  slot_available();
+
+  return slot;
 }
 
-/* Simulates the write operation for the block block_num of file file_id, 
- * for the thread pid. It sets the dirty flag in the cache slot for the block.
- * Returns 0 if the block was needed to be fetched from the disk, 
- *         1 if the block was found in the cache
- *         2 if the requested block was invalid
+/* Drop every cached block of file_id without writing it back, as when
+ * the file is deleted, and put the slots on pid's free list so that the
+ * next misses fill them before anything else is evicted. A block that
+ * is being fetched while this runs is not dropped. Returns the number
+ * of blocks dropped.
  */
-int write_block(int pid, int file_id, int block_num) {
-  /* check if file_id i s valid */
-  if((file_id < 0) || (file_id >= NUM_FILES)){
-    return 2;
+int invalidate_file(int pid, int file_id) {
+  int dropped = 0;
+  int size = get_file_size(file_id);
+
+  for(int block_num = 0; block_num < size; block_num++){
+    int slot = ht_lookup(file_id, block_num);
+    if(slot == -1)
+      continue;
+
+    sim_lock_acquire(&cache_locks[slot]);
+    if((cache[slot].file_id != file_id) || (cache[slot].block_num != block_num)){
+      sim_lock_release(&cache_locks[slot]);
+      continue;
+    }
+    evict_block(slot, 1);
+    dropped++;
+
+    /* if the policy has just handed the slot out as a victim, the
+     * thread that got it will fill it; otherwise it is free */
+    int freed = cache_policy->forget(slot);
+    sim_lock_release(&cache_locks[slot]);
+
+    if(freed){
+      fl_put(pid, slot);
+      slot_available();
+    }
   }
 
-  pthread_mutex_lock(&ftable_locks[file_id]);
-  bNode *node = NULL;
-  int found = 0;
-  
-  /* check if invalid request */
-  if((block_num < 0) || (block_num >= get_file_size(file_id))){
-    pthread_mutex_unlock(&ftable_locks[file_id]);
+  __atomic_add_fetch(&invalidated, dropped, __ATOMIC_RELAXED);
+  return dropped;
+}
 
-    return 2;
-  } else if((node = bNode_search(ftable[file_id].head, block_num)) != NULL){
-    /* if block found in cache */
-    found = 1;
-    int slot = node->cache_index;
-    pthread_mutex_unlock(&ftable_locks[file_id]);
+/* the fetch of a block in progress, if any; call with fetch_lock held */
+static struct fetch *find_fetch(int file_id, int block_num) {
+  struct fetch *f;
+  for(f = fetches; f != NULL; f = f->next){
+    if((f->file_id == file_id) && (f->block_num == block_num))
+      break;
+  }
+  return f;
+}
 
-    /* lock slot and write */
-    pthread_mutex_lock(&cache_locks[slot]);
+/* Announce that the caller is fetching a block; call with fetch_lock
+ * held, after checking that nobody else is */
+static void fetch_start(struct fetch *mine, int file_id, int block_num) {
+  mine->file_id = file_id;
+  mine->block_num = block_num;
+  mine->done = 0;
+  mine->waiters = 0;
+  mine->next = fetches;
+  fetches = mine;
+}
 
-    /* check if slot hasn't been re-written */
-    if((cache[slot].file_id == file_id) && (cache[slot].block_num == block_num)){
-#ifdef DEBUG
-    printf("file %d, block %d, slot %d, write to cache\n", file_id, block_num, slot);
-#endif
-    /* sleep for MEM_TIME */
-    struct timespec sleep_time;
-    sleep_timespec(&sleep_time, MEM_TIME);
-    nanosleep(&sleep_time, NULL);
+/* Finish a fetch: hand the slot to the waiters, and keep the entry
+ * alive until the last of them has read it. */
+static void fetch_done(struct fetch *mine, int slot) {
+  pthread_mutex_lock(&fetch_lock);
+  struct fetch **link = &fetches;
+  while(*link != mine)
+    link = &(*link)->next;
+  *link = mine->next;
+
+  mine->slot = slot;
+  mine->done = 1;
+  sim_cond_broadcast(&fetch_cv);
+  while(mine->waiters > 0)
+    sim_cond_wait(&fetch_cv, &fetch_lock);
+  pthread_mutex_unlock(&fetch_lock);
+}
 
-    /* update dirty flag */
-    cache[slot].dirty = 1;
+/* Body of a prefetch thread: load queued blocks unless they are cached
+ * or being fetched already. Demand misses on a block being prefetched
+ * wait for it like for any other fetch.
+ */
+static void *prefetcher(void *arg) {
+  int id = (long)arg;
 
-    pthread_mutex_unlock(&cache_locks[slot]);
-    return 1;
-    } else {
-#ifdef DEBUG
-    printf("file %d, block %d, slot %d, slot overwritten\n", file_id, block_num, slot);
-#endif
-    pthread_mutex_unlock(&cache_locks[slot]);
+  /* read-ahead should displace clean blocks, see policy.h */
+  prefetching = 1;
+
+  pthread_mutex_lock(&pf_lock);
+  for(;;){
+    while((pf_len == 0) && !pf_stopping)
+      sim_cond_wait(&pf_cv, &pf_lock);
+    if(pf_stopping)
+      break;
+
+    struct pf_req req = pf_queue[pf_head];
+    pf_head = (pf_head + 1) % PF_QUEUE;
+    pf_len--;
+    pthread_mutex_unlock(&pf_lock);
+
+    struct fetch mine;
+    pthread_mutex_lock(&fetch_lock);
+    int busy = (find_fetch(req.file_id, req.block_num) != NULL) ||
+      (ht_lookup(req.file_id, req.block_num) != -1);
+    if(!busy)
+      fetch_start(&mine, req.file_id, req.block_num);
+    pthread_mutex_unlock(&fetch_lock);
+
+    if(!busy){
+      int slot = load_block(id, req.file_id, req.block_num, 0, 1);
+      __atomic_add_fetch(&pf_issued, 1, __ATOMIC_RELAXED);
+      fetch_done(&mine, slot);
     }
+
+    pthread_mutex_lock(&pf_lock);
   }
+  pthread_mutex_unlock(&pf_lock);
+
+  sim_thread_exit();
+  return NULL;
+}
 
-  /* if block was found then file has already been unlocked */
-  if(found == 0){
-    /* unlock file since we're not going to modify it until
-     * we've copied the block over to the cache */
-    pthread_mutex_unlock(&ftable_locks[file_id]);
+/* Follow pid's stream through file_id and, once it is sequential, queue
+ * the blocks up to prefetch_depth ahead that have not been queued yet.
+ */
+static void readahead(int pid, int file_id, int block_num) {
+  int i = block_hash(pid, file_id) % STREAMS;
+  struct stream *s = &streams[i];
+  int from, to;
+
+  pthread_mutex_lock(&stream_locks[i]);
+  if((s->pid == pid) && (s->file_id == file_id) && (s->next == block_num)){
+    s->run++;
+  } else {
+    /* a new stream, or a seek; start counting again */
+    s->pid = pid;
+    s->file_id = file_id;
+    s->run = 1;
+    s->ahead = block_num + 1;
   }
+  s->next = block_num + 1;
+
+  from = s->ahead > block_num + 1 ? s->ahead : block_num + 1;
+  to = block_num + prefetch_depth;
+  if(to >= get_file_size(file_id))
+    to = get_file_size(file_id) - 1;
+  if(s->run < 2)
+    to = from - 1;
+  else if(to >= from)
+    s->ahead = to + 1;
+  pthread_mutex_unlock(&stream_locks[i]);
+
+  if(to < from)
+    return;
+
+  pthread_mutex_lock(&pf_lock);
+  for(int b = from; (b <= to) && (pf_len < PF_QUEUE); b++){
+    pf_queue[(pf_head + pf_len) % PF_QUEUE].file_id = file_id;
+    pf_queue[(pf_head + pf_len) % PF_QUEUE].block_num = b;
+    pf_len++;
+    sim_cond_signal(&pf_cv);
+  }
+  pthread_mutex_unlock(&pf_lock);
+}
 
-  /* get empty slot if available else randomly select one */
-  int slot = get_empty_slot();
-  if(slot == -1){
-    slot = Equilikely(0, NUM_SLOTS-1);
+/* Common body of read_block and write_block; write is 1 for a write.
+ * Returns 0 if the block was needed to be fetched from the disk, 
+ *         1 if the block was found in the cache
+ *         2 if the requested block was invalid
+ */
+static int access_block(int pid, int file_id, int block_num, int write) {
+  /* check if invalid request */
+  if((file_id < 0) || (file_id >= num_files) ||
+      (block_num < 0) || (block_num >= get_file_size(file_id))){
+    return 2;
   }
 
-#ifdef DEBUG
-  printf("file %d, block %d, slot %d, write to disk\n", file_id, block_num, slot);
-#endif
-  pthread_mutex_lock(&cache_locks[slot]);
+  /* start reading ahead before waiting for this block */
+  if(prefetch_depth > 0)
+    readahead(pid, file_id, block_num);
 
-  /* if block not empty, evict it */
-  if(cache[slot].file_id != -1){
-    evict_block(slot);
-  }
+  /* whether the next lookup must not miss an indexed block */
+  int exact = locked_hits;
 
-  /* copy block from disk to cache
-   * i.e. sleep for DISK_TIME */
-  struct timespec sleep_time;
-  sleep_timespec(&sleep_time, DISK_TIME);
+  for(;;){
+    int slot = exact ? ht_lookup(file_id, block_num) :
+      ht_lookup_fast(file_id, block_num);
+    if((slot != -1) && hit_slot(slot, file_id, block_num, write))
+      return 1;
 
-  /* only one thread can access disk at a time */
-  pthread_mutex_lock(&io_lock);
-  nanosleep(&sleep_time, NULL);
-  pthread_mutex_unlock(&io_lock);
+    pthread_mutex_lock(&fetch_lock);
+
+    /* join a fetch of the same block if one is in progress */
+    struct fetch *f = find_fetch(file_id, block_num);
+    if(f != NULL){
+      f->waiters++;
+      while(!f->done)
+        sim_cond_wait(&fetch_cv, &fetch_lock);
+      slot = f->slot;
+      if(--f->waiters == 0)
+        sim_cond_broadcast(&fetch_cv);
+      pthread_mutex_unlock(&fetch_lock);
+
+      /* it counts as a miss, the block still came from the disk; if
+       * it was evicted again before we got to it, start over */
+      if(hit_slot(slot, file_id, block_num, write)){
+        __atomic_add_fetch(&coalesced, 1, __ATOMIC_RELAXED);
+        return 0;
+      }
+      continue;
+    }
 
-  /* update the slot with block info */
-  cache[slot].file_id = file_id;
-  cache[slot].block_num = block_num;
-  cache[slot].dirty = 1;
+    /* a fetch may have completed between the lookup and taking
+     * fetch_lock; completed fetches are indexed before they leave
+     * the list, so looking again is enough */
+    if(ht_lookup(file_id, block_num) != -1){
+      pthread_mutex_unlock(&fetch_lock);
+      exact = 1;
+      continue;
+    }
 
-  /* now add the block info to file list */
-  pthread_mutex_lock(&ftable_locks[file_id]);
-  ftable[file_id].head = bNode_add(ftable[file_id].head, block_num, slot);
-  pthread_mutex_unlock(&ftable_locks[file_id]);
+    struct fetch mine;
+    fetch_start(&mine, file_id, block_num);
+    pthread_mutex_unlock(&fetch_lock);
 
-  pthread_mutex_unlock(&cache_locks[slot]);
+    slot = load_block(pid, file_id, block_num, write, 0);
+    fetch_done(&mine, slot);
 
-  return 0;
+    return 0;
+  }
 }
 
-int __main(int argc, char **argv){
-  build_file_table();
-  init_cache();
-
-  /* read a couple of block from file 0 */
-  read_block(0, 0, 1);
-  read_block(0, 2, 1);
-  read_block(0, 0, 2);
-  read_block(0, 2, 2);
-  read_block(0, 0, 3);
-  read_block(0, 2, 3);
-  read_block(0, 0, 4);
-  read_block(0, 2, 4);
-  read_block(0, 0, 5);
-  read_block(0, 2, 5);
-  read_block(0, 0, 6);
-  read_block(0, 2, 6);
-  read_block(0, 0, 7);
-  read_block(0, 2, 7);
-  read_block(0, 0, 8);
-  read_block(0, 2, 8);
-  read_block(0, 0, 9);
-  read_block(0, 2, 9);
-  read_block(0, 0, 10);
-  read_block(0, 2, 10);
-
-  read_block(0, 0, 0);
-
-  for(int i=0; i < NUM_FILES; i++){
-    ftable[i].head = bNode_free_list(ftable[i].head);
-  }
+/* Simulates the read operation for the block block_num of file file_id, 
+ * for the thread pid.
+ * Returns 0 if the block was needed to be fetched from the disk, 
+ *         1 if the block was found in the cache
+ *         2 if the requested block was invalid
+ */
+int read_block(int pid, int file_id, int block_num) {
+  return access_block(pid, file_id, block_num, 0);
+}
 
-  return 0;
+/* Simulates the write operation for the block block_num of file file_id, 
+ * for the thread pid. It sets the dirty flag in the cache slot for the block.
+ * Returns 0 if the block was needed to be fetched from the disk, 
+ *         1 if the block was found in the cache
+ *         2 if the requested block was invalid
+ */
+int write_block(int pid, int file_id, int block_num) {
+  return access_block(pid, file_id, block_num, 1);
 }
@@ -4,6 +4,10 @@
  * $Id$
  */
 
+/* NUM_FILES, NUM_SLOTS, NUM_PROCESSES and READ_PROB are only the
+ * defaults; simcache can override each of them on the command line.
+ */
+
 #define MEAN_FILE_SIZE 20
 #define NUM_FILES 5         /* The number of files in the file table */
 #define NUM_SLOTS 20        /* The number of slots in the cache array */
@@ -21,8 +25,22 @@
 #define MAX_COMPUTE_TIME 99
 
 int get_file_size(int fileid);
-void build_file_table();
+int get_num_files();
+void build_file_table(int nfiles);
+void set_file_table(const int *sizes, int nfiles);
+void set_cache_size(int slots);
+int set_policy(const char *name);
+void set_disk(int channels, int depth, int service_time);
+void set_flusher(double ratio);
+void set_prefetch(int depth);
+void set_mem_time(int msec);
+void set_locked_hits(int locked);
 void init_cache();
+void destroy_cache();
+void cache_io_stats(long *reads, long *writes, long *shared);
+void cache_free_stats(long *dropped, long *reused);
+void cache_prefetch_stats(long *issued, long *used, long *wasted, long *unused);
 
 int read_block(int pid, int id, int blocknum);
 int write_block(int pid, int id, int blocknum);
+int invalidate_file(int pid, int id);
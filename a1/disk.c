@@ -0,0 +1,172 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "common.h"
+#include "simtime.h"
+#include "disk.h"
+
+/* most channels a disk may be configured with */
+#define MAX_CHANNELS 64
+
+/* protects everything below */
+pthread_mutex_t disk_lock;
+
+/* signalled when a request is queued or the disk shuts down */
+struct sim_cond disk_work;
+
+/* signalled when a request leaves the device */
+struct sim_cond disk_space;
+
+/* broadcast whenever a request completes */
+struct sim_cond disk_done;
+
+/* FIFO of requests waiting for a channel */
+struct disk_req *queue_head, *queue_tail;
+
+int disk_depth;           /* most requests outstanding at once */
+int disk_outstanding;     /* requests queued or in service */
+int disk_service_time;    /* milliseconds per request */
+int disk_stopping;
+
+long disk_reads, disk_writes;
+
+int disk_channels;
+pthread_t disk_threads[MAX_CHANNELS];
+
+/* body of one channel: serve requests in arrival order */
+static void *disk_service(void *arg) {
+  pthread_mutex_lock(&disk_lock);
+  for(;;){
+    while((queue_head == NULL) && !disk_stopping)
+      sim_cond_wait(&disk_work, &disk_lock);
+    if(queue_head == NULL)
+      break;
+
+    struct disk_req *req = queue_head;
+    queue_head = req->next;
+    if(queue_head == NULL)
+      queue_tail = NULL;
+    pthread_mutex_unlock(&disk_lock);
+
+    /* transfer the block */
+    sim_sleep(disk_service_time);
+
+    pthread_mutex_lock(&disk_lock);
+    if(req->op == DISK_READ)
+      disk_reads++;
+    else
+      disk_writes++;
+    req->done = 1;
+    disk_outstanding--;
+    sim_cond_broadcast(&disk_done);
+    sim_cond_signal(&disk_space);
+  }
+  pthread_mutex_unlock(&disk_lock);
+
+  sim_thread_exit();
+
+  return NULL;
+}
+
+/* Start a disk with the given number of channels, queue depth and per
+ * request service time in milliseconds.
+ */
+void disk_init(int channels, int depth, int service_time) {
+  if((channels < 1) || (channels > MAX_CHANNELS) || (depth < 1)){
+    fprintf(stderr, "Invalid disk configuration\n");
+    exit(1);
+  }
+
+  if(pthread_mutex_init(&disk_lock, NULL) != 0){
+    fprintf(stderr, "Error Initializing Mutex\n");
+    exit(1);
+  }
+  sim_cond_init(&disk_work);
+  sim_cond_init(&disk_space);
+  sim_cond_init(&disk_done);
+
+  queue_head = queue_tail = NULL;
+  disk_depth = depth;
+  disk_outstanding = 0;
+  disk_service_time = service_time;
+  disk_stopping = 0;
+  disk_reads = disk_writes = 0;
+
+  disk_channels = channels;
+  sim_thread_add(channels);
+  for(int i = 0; i < channels; i++){
+    if(pthread_create(&disk_threads[i], NULL, disk_service, NULL) != 0){
+      fprintf(stderr, "Error creating thread\n");
+      exit(1);
+    }
+  }
+}
+
+/* finish every queued request, then stop the service threads */
+void disk_shutdown() {
+  pthread_mutex_lock(&disk_lock);
+  disk_stopping = 1;
+  sim_cond_broadcast(&disk_work);
+  pthread_mutex_unlock(&disk_lock);
+
+  for(int i = 0; i < disk_channels; i++)
+    pthread_join(disk_threads[i], NULL);
+
+  pthread_mutex_destroy(&disk_lock);
+  sim_cond_destroy(&disk_work);
+  sim_cond_destroy(&disk_space);
+  sim_cond_destroy(&disk_done);
+}
+
+/* queue a request, blocking while the device is full */
+void disk_submit(struct disk_req *req) {
+  req->done = 0;
+  req->next = NULL;
+
+  pthread_mutex_lock(&disk_lock);
+  while(disk_outstanding >= disk_depth)
+    sim_cond_wait(&disk_space, &disk_lock);
+
+  disk_outstanding++;
+  if(queue_tail != NULL)
+    queue_tail->next = req;
+  else
+    queue_head = req;
+  queue_tail = req;
+
+  sim_cond_signal(&disk_work);
+  pthread_mutex_unlock(&disk_lock);
+}
+
+/* block until a submitted request has completed */
+void disk_wait(struct disk_req *req) {
+  pthread_mutex_lock(&disk_lock);
+  while(!req->done)
+    sim_cond_wait(&disk_done, &disk_lock);
+  pthread_mutex_unlock(&disk_lock);
+}
+
+/* transfer one block synchronously */
+void disk_io(int file_id, int block_num, int op) {
+  struct disk_req req;
+  req.file_id = file_id;
+  req.block_num = block_num;
+  req.op = op;
+
+  disk_submit(&req);
+  disk_wait(&req);
+}
+
+/* blocks transferred in each direction since disk_init */
+void disk_stats(long *reads, long *writes) {
+  pthread_mutex_lock(&disk_lock);
+  *reads = disk_reads;
+  *writes = disk_writes;
+  pthread_mutex_unlock(&disk_lock);
+}
@@ -0,0 +1,33 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+/* Simulated disk: a pool of service threads draining a FIFO request
+ * queue. Each service thread models one channel of the device, so one
+ * channel behaves like the original single-armed disk and several
+ * behave like a parallel (SSD style) device. The queue depth bounds how
+ * many requests may be outstanding (queued or in service); submitters
+ * block while it is full.
+ */
+
+#define DISK_READ 0
+#define DISK_WRITE 1
+
+struct disk_req {
+  int file_id;
+  int block_num;
+  int op;               /* DISK_READ or DISK_WRITE */
+  int done;             /* set by the service thread on completion */
+  struct disk_req *next;
+};
+
+void disk_init(int channels, int depth, int service_time);
+void disk_shutdown();
+
+void disk_submit(struct disk_req *req);
+void disk_wait(struct disk_req *req);
+void disk_io(int file_id, int block_num, int op);
+
+void disk_stats(long *reads, long *writes);
@@ -0,0 +1,107 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "freelist.h"
+
+/* most shards; a small cache gets one per slot */
+#define FL_SHARDS 16
+
+/* size of a cache line, to keep the shards' locks apart */
+#define CACHE_LINE 64
+
+struct shard {
+  pthread_mutex_t lock;
+  int head;               /* first free slot, -1 if none */
+} __attribute__((aligned(CACHE_LINE)));
+
+struct shard *shards;
+int nshards;
+
+/* next free slot after each slot on the same shard */
+int *fl_next;
+
+/* free slots over all shards */
+int fl_count;
+
+/* start with every slot free, dealt out to the shards in order */
+void fl_init(int nslots) {
+  void *mem;
+  nshards = nslots < FL_SHARDS ? nslots : FL_SHARDS;
+  if(posix_memalign(&mem, CACHE_LINE, nshards * sizeof(struct shard)) != 0)
+    mem = NULL;
+  shards = mem;
+  fl_next = malloc(nslots * sizeof(int));
+  if((shards == NULL) || (fl_next == NULL)){
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+
+  for(int i = 0; i < nshards; i++){
+    if(pthread_mutex_init(&shards[i].lock, NULL) != 0){
+      fprintf(stderr, "Error Initializing Mutex\n");
+      exit(1);
+    }
+    shards[i].head = -1;
+  }
+
+  /* push in reverse, so each shard hands out its slots lowest first */
+  for(int slot = nslots - 1; slot >= 0; slot--){
+    struct shard *s = &shards[slot % nshards];
+    fl_next[slot] = s->head;
+    s->head = slot;
+  }
+  fl_count = nslots;
+}
+
+void fl_destroy() {
+  for(int i = 0; i < nshards; i++)
+    pthread_mutex_destroy(&shards[i].lock);
+  free(shards);
+  free(fl_next);
+}
+
+/* take a slot off shard s, -1 if it is empty */
+static int shard_pop(struct shard *s) {
+  pthread_mutex_lock(&s->lock);
+  int slot = s->head;
+  if(slot != -1)
+    s->head = fl_next[slot];
+  pthread_mutex_unlock(&s->lock);
+  return slot;
+}
+
+/* Return a free slot, preferring pid's own shard, or -1 if there is
+ * none.
+ */
+int fl_get(int pid) {
+  if(__atomic_load_n(&fl_count, __ATOMIC_ACQUIRE) == 0)
+    return -1;
+
+  int home = (unsigned int)pid % nshards;
+  for(int i = 0; i < nshards; i++){
+    int slot = shard_pop(&shards[(home + i) % nshards]);
+    if(slot != -1){
+      __atomic_sub_fetch(&fl_count, 1, __ATOMIC_RELAXED);
+      return slot;
+    }
+  }
+  return -1;
+}
+
+/* give an empty slot back, to pid's own shard */
+void fl_put(int pid, int slot) {
+  struct shard *s = &shards[(unsigned int)pid % nshards];
+
+  pthread_mutex_lock(&s->lock);
+  fl_next[slot] = s->head;
+  s->head = slot;
+  pthread_mutex_unlock(&s->lock);
+
+  __atomic_add_fetch(&fl_count, 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,21 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+/* Free cache slots: empty at start up, or emptied by invalidate_file.
+ *
+ * The slots are spread over several shards, each a stack with its own
+ * lock. A thread takes from and returns to its home shard (chosen by
+ * pid) and only looks at the others when that one is empty, so misses
+ * from different threads rarely meet on a lock. A count of free slots
+ * lets a miss find out there are none without taking any lock, which
+ * is the common case once the cache has filled.
+ */
+
+void fl_init(int nslots);
+void fl_destroy();
+
+int fl_get(int pid);
+void fl_put(int pid, int slot);
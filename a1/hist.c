@@ -0,0 +1,77 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+#include <string.h>
+#include "hist.h"
+
+/* log2 of HIST_SUB */
+#define HIST_SHIFT 4
+
+/* bucket holding a value of ns nanoseconds */
+static int hist_index(unsigned long long ns) {
+  if(ns < HIST_SUB)
+    return ns;
+
+  /* e is how far ns must be shifted to leave HIST_SUB..2*HIST_SUB-1 */
+  int e = (63 - __builtin_clzll(ns)) - HIST_SHIFT;
+  int i = HIST_SUB * e + (int)(ns >> e);
+  return i < HIST_BUCKETS ? i : HIST_BUCKETS - 1;
+}
+
+/* midpoint of bucket i, in ms */
+static double hist_value(int i) {
+  if(i < 2 * HIST_SUB)
+    return i / 1000000.0;
+
+  int e = i / HIST_SUB - 1;
+  double low = (double)(i - HIST_SUB * e) * (1ULL << e);
+  return (low + (1ULL << e) / 2.0) / 1000000;
+}
+
+void hist_init(struct hist *h) {
+  memset(h, 0, sizeof(*h));
+}
+
+void hist_add(struct hist *h, double msec) {
+  if(msec < 0)
+    msec = 0;
+
+  h->n++;
+  h->sum += msec;
+  if(msec > h->max)
+    h->max = msec;
+  h->bucket[hist_index(msec * 1000000)]++;
+}
+
+void hist_merge(struct hist *into, const struct hist *h) {
+  into->n += h->n;
+  into->sum += h->sum;
+  if(h->max > into->max)
+    into->max = h->max;
+  for(int i = 0; i < HIST_BUCKETS; i++)
+    into->bucket[i] += h->bucket[i];
+}
+
+double hist_mean(const struct hist *h) {
+  return h->n > 0 ? h->sum / h->n : 0;
+}
+
+/* the value below which a fraction q of the samples fall, in ms */
+double hist_quantile(const struct hist *h, double q) {
+  if(h->n == 0)
+    return 0;
+
+  long rank = q * (h->n - 1);
+  long seen = 0;
+  for(int i = 0; i < HIST_BUCKETS; i++){
+    seen += h->bucket[i];
+    if(seen > rank){
+      double v = hist_value(i);
+      return v < h->max ? v : h->max;
+    }
+  }
+  return h->max;
+}
@@ -0,0 +1,32 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+/* Latency histograms.
+ *
+ * Latencies are counted in nanosecond buckets that grow with the
+ * value: below 2 * HIST_SUB nanoseconds every value has its own bucket,
+ * above that each power of two is split into HIST_SUB buckets, so a
+ * quantile read back from the histogram is within about 3% of the
+ * true value whatever its magnitude. Adding a value is a few shifts
+ * and an increment, cheap enough to do on every access.
+ */
+
+#define HIST_SUB 16                       /* buckets per power of two */
+#define HIST_BUCKETS (HIST_SUB * 45)      /* up to 2^48 ns, about 78 hours */
+
+struct hist {
+  long n;
+  double sum;                             /* ms */
+  double max;                             /* ms */
+  long bucket[HIST_BUCKETS];
+};
+
+void hist_init(struct hist *h);
+void hist_add(struct hist *h, double msec);
+void hist_merge(struct hist *into, const struct hist *h);
+
+double hist_mean(const struct hist *h);
+double hist_quantile(const struct hist *h, double q);
@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+
+# Compare read hit throughput with lock-free (seqlock validated) hits
+# against locked hits as the number of processes grows. Every run has
+# no compute, memory or disk time and a cache large enough for all
+# files, so after the first pass every access is a hit. Every policy is
+# measured; extra arguments are passed on to simcache.
+
+echo -e "Read Hit Throughput\n"
+
+make -s simcache
+
+for policy in random lru clock 2q arc
+do
+  echo "Policy ${policy}:"
+  for procs in 1 2 4 8 16 32 64 128 256
+  do
+    for mode in lock-free locked
+    do
+      flag=''
+      if [ ${mode} = locked ]
+      then
+        flag='-L'
+      fi
+
+      echo -n "processes: ${procs}, ${mode}: "
+      ./simcache -Z -d 0 -r 1 -n 200 -i 2000 -P ${procs} -p ${policy} ${flag} "$@" |
+        grep '^Throughput'
+    done
+  done
+  echo
+done
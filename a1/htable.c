@@ -0,0 +1,154 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "common.h"
+#include "htable.h"
+
+
+struct ht_node {
+  int file_id;
+  int block_num;
+  int next;       /* index of the next node in the bucket, -1 at the end */
+};
+
+/* node i belongs to cache slot i */
+struct ht_node *ht_nodes;
+int ht_nslots;
+
+/* Twice as many buckets as slots keeps the expected chain length
+ * below one, so a lookup costs the same however large the cache is.
+ */
+int ht_buckets;
+
+/* index of the first node in each bucket, -1 if empty */
+int *ht_heads;
+
+/* array of mutexes for each bucket */
+pthread_mutex_t *ht_locks;
+
+/* mix a block's identity into a well spread hash value */
+unsigned int block_hash(int file_id, int block_num){
+  unsigned int h = (unsigned int)file_id * 2654435761u;
+  h ^= (unsigned int)block_num + 0x9e3779b9u + (h << 6) + (h >> 2);
+  return h;
+}
+
+/* map a block to its bucket */
+static unsigned int ht_hash(int file_id, int block_num){
+  return block_hash(file_id, block_num) % ht_buckets;
+}
+
+/* set up an empty index for a cache of nslots slots */
+void ht_init(int nslots){
+  ht_nslots = nslots;
+  ht_buckets = 2 * nslots;
+  ht_nodes = malloc(nslots * sizeof(struct ht_node));
+  ht_heads = malloc(ht_buckets * sizeof(int));
+  ht_locks = malloc(ht_buckets * sizeof(pthread_mutex_t));
+  if((ht_nodes == NULL) || (ht_heads == NULL) || (ht_locks == NULL)){
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+
+  for(int i = 0; i < nslots; i++){
+    ht_nodes[i].file_id = -1;
+    ht_nodes[i].next = -1;
+  }
+
+  for(int i = 0; i < ht_buckets; i++){
+    ht_heads[i] = -1;
+
+    if(pthread_mutex_init(&ht_locks[i], NULL) != 0){
+      fprintf(stderr, "Error Initializing Mutex\n");
+      exit(1);
+    }
+  }
+}
+
+void ht_destroy(){
+  for(int i = 0; i < ht_buckets; i++)
+    pthread_mutex_destroy(&ht_locks[i]);
+
+  free(ht_nodes);
+  free(ht_heads);
+  free(ht_locks);
+}
+
+/* return the slot holding the block if indexed, else -1 */
+int ht_lookup(int file_id, int block_num){
+  unsigned int b = ht_hash(file_id, block_num);
+  int slot = -1;
+
+  pthread_mutex_lock(&ht_locks[b]);
+  for(int i = ht_heads[b]; i != -1; i = ht_nodes[i].next){
+    if((ht_nodes[i].file_id == file_id) && (ht_nodes[i].block_num == block_num)){
+      slot = i;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&ht_locks[b]);
+
+  return slot;
+}
+
+/* Lock-free lookup for the hit path. Nodes may be unlinked or move to
+ * another bucket during the walk, so this can miss a block that is
+ * indexed, and the slot it returns may already hold another block; the
+ * caller has to check the slot itself, and use ht_lookup when a miss
+ * must be certain.
+ */
+int ht_lookup_fast(int file_id, int block_num){
+  unsigned int b = ht_hash(file_id, block_num);
+
+  int i = __atomic_load_n(&ht_heads[b], __ATOMIC_ACQUIRE);
+  /* a node moving under us could lead the walk around in circles */
+  for(int steps = 0; (i != -1) && (steps < ht_nslots); steps++){
+    if((__atomic_load_n(&ht_nodes[i].file_id, __ATOMIC_RELAXED) == file_id) &&
+        (__atomic_load_n(&ht_nodes[i].block_num, __ATOMIC_RELAXED) == block_num))
+      return i;
+    i = __atomic_load_n(&ht_nodes[i].next, __ATOMIC_ACQUIRE);
+  }
+  return -1;
+}
+
+/* index the block held in slot; the slot must not already be indexed */
+void ht_insert(int file_id, int block_num, int slot){
+  unsigned int b = ht_hash(file_id, block_num);
+
+  /* links are published with release stores for ht_lookup_fast */
+  pthread_mutex_lock(&ht_locks[b]);
+  __atomic_store_n(&ht_nodes[slot].file_id, file_id, __ATOMIC_RELAXED);
+  __atomic_store_n(&ht_nodes[slot].block_num, block_num, __ATOMIC_RELAXED);
+  __atomic_store_n(&ht_nodes[slot].next, ht_heads[b], __ATOMIC_RELAXED);
+  __atomic_store_n(&ht_heads[b], slot, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&ht_locks[b]);
+}
+
+/* drop whatever mapping slot currently has, if any */
+void ht_remove(int slot){
+  /* the node is only changed by the thread holding the slot's lock,
+   * so its key can be read before taking the bucket lock */
+  if(ht_nodes[slot].file_id == -1)
+    return;
+
+  unsigned int b = ht_hash(ht_nodes[slot].file_id, ht_nodes[slot].block_num);
+
+  pthread_mutex_lock(&ht_locks[b]);
+  int *link = &ht_heads[b];
+  while(*link != -1){
+    if(*link == slot){
+      __atomic_store_n(link, ht_nodes[slot].next, __ATOMIC_RELEASE);
+      break;
+    }
+    link = &ht_nodes[*link].next;
+  }
+  __atomic_store_n(&ht_nodes[slot].file_id, -1, __ATOMIC_RELAXED);
+  __atomic_store_n(&ht_nodes[slot].next, -1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&ht_locks[b]);
+}
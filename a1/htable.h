@@ -0,0 +1,20 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+/* Concurrent index from (file_id, block_num) to the cache slot holding
+ * that block. Each cache slot owns exactly one preallocated node, so
+ * adding or removing a mapping never allocates memory.
+ */
+
+unsigned int block_hash(int file_id, int block_num);
+
+void ht_init(int nslots);
+void ht_destroy();
+
+int ht_lookup(int file_id, int block_num);
+int ht_lookup_fast(int file_id, int block_num);
+void ht_insert(int file_id, int block_num, int slot);
+void ht_remove(int slot);
@@ -0,0 +1,697 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "rv.h"
+#include "common.h"
+#include "htable.h"
+#include "policy.h"
+
+/* All list based policies keep their state under this one lock. Misses
+ * already wait DISK_TIME, so the lock is never the bottleneck there, and
+ * no policy takes it on a hit (see Deferred hits).
+ */
+pthread_mutex_t policy_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* set by the cache while its flusher runs, and by each prefetch
+ * thread for itself, see policy.h */
+int prefer_clean = 0;
+__thread int prefetching = 0;
+
+#define WANT_CLEAN (prefer_clean || prefetching)
+
+/* how far from the LRU end a list policy looks for a clean victim */
+#define CLEAN_WINDOW 32
+
+/* how many random picks the random policy makes looking for a clean one */
+#define CLEAN_TRIES 8
+
+/* number of slots in the cache, set by each policy's init */
+static int nslots;
+
+/* the block each slot was last filled with, for the ghost lists */
+int *pfile;
+int *pblock;
+
+/* ================================================================
+ * Slot lists: intrusive doubly linked lists of slot numbers, most
+ * recently used at the head. A slot is on at most one list.
+ * ================================================================
+ */
+struct slist {
+  int head;
+  int tail;
+  int len;
+};
+
+int *lprev;
+int *lnext;
+struct slist **lowner;  /* list the slot is on, NULL if none */
+
+static void list_reset(struct slist *l){
+  l->head = l->tail = -1;
+  l->len = 0;
+}
+
+/* insert slot at the head (MRU end) of l */
+static void list_push(struct slist *l, int slot){
+  lprev[slot] = -1;
+  lnext[slot] = l->head;
+  if(l->head != -1)
+    lprev[l->head] = slot;
+  else
+    l->tail = slot;
+  l->head = slot;
+  l->len++;
+  lowner[slot] = l;
+}
+
+/* unlink slot from whatever list it is on */
+static void list_remove(int slot){
+  struct slist *l = lowner[slot];
+  if(l == NULL)
+    return;
+
+  if(lprev[slot] != -1)
+    lnext[lprev[slot]] = lnext[slot];
+  else
+    l->head = lnext[slot];
+
+  if(lnext[slot] != -1)
+    lprev[lnext[slot]] = lprev[slot];
+  else
+    l->tail = lprev[slot];
+
+  l->len--;
+  lowner[slot] = NULL;
+}
+
+/* Remove and return the victim from l: the slot closest to the LRU end
+ * that is clean, looking no further than CLEAN_WINDOW slots, or the
+ * tail when there is none or clean victims are not wanted. -1 if l is empty.
+ */
+static int list_pick(struct slist *l){
+  int slot = l->tail;
+
+  if(WANT_CLEAN){
+    int s = l->tail;
+    for(int i = 0; (s != -1) && (i < CLEAN_WINDOW); i++, s = lprev[s]){
+      if(slot_is_clean(s)){
+        slot = s;
+        break;
+      }
+    }
+  }
+
+  if(slot != -1)
+    list_remove(slot);
+  return slot;
+}
+
+/* forget for the list based policies: take slot off its list */
+static int list_forget(int slot){
+  pthread_mutex_lock(&policy_lock);
+  int listed = lowner[slot] != NULL;
+  list_remove(slot);
+  pthread_mutex_unlock(&policy_lock);
+  return listed;
+}
+
+/* ================================================================
+ * Deferred hits: LRU, 2Q and ARC reorder their lists on a hit, but a
+ * hit takes no lock. It only sets the slot's referenced bit, and the
+ * first hit since the bit was last cleared also pushes the slot onto
+ * a lock-free stack of pending hits, so each slot is on the stack at
+ * most once. victim and fill take the whole stack under policy_lock
+ * and apply the moves, oldest hit first, before they look at the lists.
+ * ================================================================
+ */
+int *hit_ref;           /* 1 while the slot is on the pending stack */
+int *hit_next;          /* next slot down the pending stack */
+int hit_pending = -1;   /* top of the pending stack, -1 if empty */
+
+/* hit callback of the list policies */
+static void list_hit(int slot){
+  /* acquire pairs with the release in hits_drain, which has read the
+   * slot's old link by the time it clears the bit */
+  if(__atomic_exchange_n(&hit_ref[slot], 1, __ATOMIC_ACQUIRE))
+    return;
+
+  /* only pushes race here; the whole stack is taken at once, so a
+   * plain CAS push has no ABA problem */
+  int top = __atomic_load_n(&hit_pending, __ATOMIC_RELAXED);
+  do {
+    hit_next[slot] = top;
+  } while(!__atomic_compare_exchange_n(&hit_pending, &top, slot, 1,
+        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* Apply the pending hits with touch, oldest first. Call with
+ * policy_lock held. */
+static void hits_drain(void (*touch)(int slot)){
+  int s = __atomic_exchange_n(&hit_pending, -1, __ATOMIC_ACQUIRE);
+
+  /* the stack is newest first; reverse it. No slot on it can be
+   * pushed again while its bit is still set, so the links are ours */
+  int oldest = -1;
+  while(s != -1){
+    int next = hit_next[s];
+    hit_next[s] = oldest;
+    oldest = s;
+    s = next;
+  }
+
+  /* once a slot's bit is cleared a new hit may push it and overwrite
+   * its link, so read the link first */
+  for(s = oldest; s != -1; ){
+    int next = hit_next[s];
+    __atomic_store_n(&hit_ref[s], 0, __ATOMIC_RELEASE);
+    touch(s);
+    s = next;
+  }
+}
+
+static void lists_init(){
+  for(int i = 0; i < nslots; i++){
+    lowner[i] = NULL;
+    hit_ref[i] = 0;
+  }
+  hit_pending = -1;
+}
+
+/* ================================================================
+ * Ghost lists: remember the identity of recently evicted blocks (no
+ * slot), in LRU order, with a small hash for membership tests. All
+ * ghost lists share one preallocated pool of nodes.
+ * ================================================================
+ */
+#define GHOSTS (2 * nslots)
+#define GHOST_BUCKETS (2 * nslots)
+
+struct glist {
+  int head;
+  int tail;
+  int len;
+};
+
+struct ghost {
+  int file_id;
+  int block_num;
+  int prev, next;       /* position in the owning list */
+  int chain;            /* next ghost in the same hash bucket */
+  struct glist *owner;  /* NULL while on the free list */
+};
+
+struct ghost *ghosts;
+int *ghost_heads;
+int ghost_free;         /* free nodes, linked through next */
+
+static void glist_reset(struct glist *l){
+  l->head = l->tail = -1;
+  l->len = 0;
+}
+
+static void ghosts_init(){
+  for(int i = 0; i < GHOST_BUCKETS; i++)
+    ghost_heads[i] = -1;
+
+  for(int i = 0; i < GHOSTS; i++){
+    ghosts[i].owner = NULL;
+    ghosts[i].next = i + 1 < GHOSTS ? i + 1 : -1;
+  }
+  ghost_free = 0;
+}
+
+/* return the ghost remembering the block, -1 if none */
+static int ghost_find(int file_id, int block_num){
+  int b = block_hash(file_id, block_num) % GHOST_BUCKETS;
+  for(int g = ghost_heads[b]; g != -1; g = ghosts[g].chain){
+    if((ghosts[g].file_id == file_id) && (ghosts[g].block_num == block_num))
+      return g;
+  }
+  return -1;
+}
+
+/* forget a ghost and return its node to the pool */
+static void ghost_remove(int g){
+  struct ghost *n = &ghosts[g];
+  struct glist *l = n->owner;
+
+  if(n->prev != -1)
+    ghosts[n->prev].next = n->next;
+  else
+    l->head = n->next;
+  if(n->next != -1)
+    ghosts[n->next].prev = n->prev;
+  else
+    l->tail = n->prev;
+  l->len--;
+
+  int *link = &ghost_heads[block_hash(n->file_id, n->block_num) % GHOST_BUCKETS];
+  while(*link != g)
+    link = &ghosts[*link].chain;
+  *link = n->chain;
+
+  n->owner = NULL;
+  n->next = ghost_free;
+  ghost_free = g;
+}
+
+/* forget the oldest ghost on l, if any */
+static void ghost_pop(struct glist *l){
+  if(l->tail != -1)
+    ghost_remove(l->tail);
+}
+
+/* remember a block at the head of l */
+static void ghost_push(struct glist *l, int file_id, int block_num){
+  /* the callers keep their lists bounded, so this only triggers if the
+   * pool is exhausted; fall back to recycling l's own oldest entry */
+  if(ghost_free == -1)
+    ghost_pop(l);
+  if(ghost_free == -1)
+    return;
+
+  int g = ghost_free;
+  struct ghost *n = &ghosts[g];
+  ghost_free = n->next;
+
+  n->file_id = file_id;
+  n->block_num = block_num;
+  n->owner = l;
+  n->prev = -1;
+  n->next = l->head;
+  if(l->head != -1)
+    ghosts[l->head].prev = g;
+  else
+    l->tail = g;
+  l->head = g;
+  l->len++;
+
+  int b = block_hash(file_id, block_num) % GHOST_BUCKETS;
+  n->chain = ghost_heads[b];
+  ghost_heads[b] = g;
+}
+
+/* CLOCK reference bits and residency, see below */
+int *clock_ref;
+int *clock_resident;  /* 0 while the slot is being refilled */
+
+/* list a slot chosen by arc_victim is to be filled into, NULL if the
+ * incoming block still has to be classified by arc_fill (see ARC) */
+struct slist **arc_target;
+
+/* (Re)allocate the per-slot state of every policy for a cache of n
+ * slots; each policy's init starts with this.
+ */
+static void slots_alloc(int n){
+  nslots = n;
+
+  free(pfile);
+  free(pblock);
+  free(lprev);
+  free(lnext);
+  free(lowner);
+  free(ghosts);
+  free(ghost_heads);
+  free(clock_ref);
+  free(clock_resident);
+  free(arc_target);
+  free(hit_ref);
+  free(hit_next);
+
+  pfile = malloc(n * sizeof(int));
+  pblock = malloc(n * sizeof(int));
+  lprev = malloc(n * sizeof(int));
+  lnext = malloc(n * sizeof(int));
+  lowner = malloc(n * sizeof(struct slist *));
+  ghosts = malloc(GHOSTS * sizeof(struct ghost));
+  ghost_heads = malloc(GHOST_BUCKETS * sizeof(int));
+  clock_ref = malloc(n * sizeof(int));
+  clock_resident = malloc(n * sizeof(int));
+  arc_target = malloc(n * sizeof(struct slist *));
+  hit_ref = malloc(n * sizeof(int));
+  hit_next = malloc(n * sizeof(int));
+
+  if(!pfile || !pblock || !lprev || !lnext || !lowner || !ghosts ||
+      !ghost_heads || !clock_ref || !clock_resident || !arc_target ||
+      !hit_ref || !hit_next){
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+}
+
+/* ================================================================
+ * RANDOM: the original behaviour, evict a uniformly chosen slot.
+ * ================================================================
+ */
+static void random_init(int n){
+  slots_alloc(n);
+}
+
+static void random_hit(int slot){
+}
+
+static void random_fill(int slot, int file_id, int block_num){
+}
+
+static int random_victim(int file_id, int block_num){
+  int slot = Equilikely(0, nslots-1);
+
+  for(int i = 1; WANT_CLEAN && (i < CLEAN_TRIES) && !slot_is_clean(slot); i++)
+    slot = Equilikely(0, nslots-1);
+  return slot;
+}
+
+/* random keeps no state; a victim chosen while the slot is freed just
+ * evicts nothing when it gets the slot's lock */
+static int random_forget(int slot){
+  return 1;
+}
+
+struct policy random_policy = {
+  "random", random_init, random_hit, random_fill, random_victim, random_forget
+};
+
+/* ================================================================
+ * LRU: evict the least recently used block.
+ * ================================================================
+ */
+struct slist lru_list;
+
+static void lru_init(int n){
+  slots_alloc(n);
+  lists_init();
+  list_reset(&lru_list);
+}
+
+/* apply a deferred hit */
+static void lru_touch(int slot){
+  if(lowner[slot] == &lru_list){
+    list_remove(slot);
+    list_push(&lru_list, slot);
+  }
+}
+
+static void lru_fill(int slot, int file_id, int block_num){
+  pthread_mutex_lock(&policy_lock);
+  hits_drain(lru_touch);
+  list_remove(slot);
+  list_push(&lru_list, slot);
+  pthread_mutex_unlock(&policy_lock);
+}
+
+static int lru_victim(int file_id, int block_num){
+  pthread_mutex_lock(&policy_lock);
+  hits_drain(lru_touch);
+  int slot = list_pick(&lru_list);
+  pthread_mutex_unlock(&policy_lock);
+  return slot;
+}
+
+struct policy lru_policy = {
+  "lru", lru_init, list_hit, lru_fill, lru_victim, list_forget
+};
+
+/* ================================================================
+ * CLOCK: second chance approximation of LRU. A hit only sets the
+ * slot's reference bit, so it takes no lock.
+ * ================================================================
+ */
+int clock_hand;
+
+static void clock_init(int n){
+  slots_alloc(n);
+  for(int i = 0; i < nslots; i++)
+    clock_ref[i] = clock_resident[i] = 0;
+  clock_hand = 0;
+}
+
+static void clock_hit(int slot){
+  __atomic_store_n(&clock_ref[slot], 1, __ATOMIC_RELAXED);
+}
+
+static void clock_fill(int slot, int file_id, int block_num){
+  pthread_mutex_lock(&policy_lock);
+  clock_resident[slot] = 1;
+  __atomic_store_n(&clock_ref[slot], 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&policy_lock);
+}
+
+static int clock_victim(int file_id, int block_num){
+  int slot = -1;
+
+  pthread_mutex_lock(&policy_lock);
+  /* two sweeps clear every reference bit, so a resident slot is
+   * always found unless all of them are being refilled. When clean
+   * victims are wanted the first round only takes clean slots, and
+   * dirty ones are considered in a second round if that fails. */
+  for(int round = WANT_CLEAN ? 0 : 1; (round < 2) && (slot == -1); round++){
+    for(int i = 0; i <= 2 * nslots; i++){
+      int s = clock_hand;
+      clock_hand = (clock_hand + 1) % nslots;
+
+      if(!clock_resident[s])
+        continue;
+      if(__atomic_exchange_n(&clock_ref[s], 0, __ATOMIC_RELAXED))
+        continue;
+      if((round == 0) && !slot_is_clean(s))
+        continue;
+
+      clock_resident[s] = 0;
+      slot = s;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&policy_lock);
+
+  return slot;
+}
+
+static int clock_forget(int slot){
+  pthread_mutex_lock(&policy_lock);
+  int resident = clock_resident[slot];
+  clock_resident[slot] = 0;
+  pthread_mutex_unlock(&policy_lock);
+  return resident;
+}
+
+struct policy clock_policy = {
+  "clock", clock_init, clock_hit, clock_fill, clock_victim, clock_forget
+};
+
+/* ================================================================
+ * 2Q (Johnson and Shasha, full version): new blocks enter the FIFO
+ * A1in; blocks evicted from A1in are remembered in the ghost FIFO
+ * A1out, and only a block referenced again while in A1out is promoted
+ * to the LRU list Am. One-pass sequential scans therefore never push
+ * the hot blocks out of Am.
+ * ================================================================
+ */
+#define Q_KIN ((nslots + 3) / 4)    /* target size of A1in */
+#define Q_KOUT ((nslots + 1) / 2)   /* size of A1out */
+
+struct slist q_am;
+struct slist q_a1in;
+struct glist q_a1out;
+
+static void q_init(int n){
+  slots_alloc(n);
+  lists_init();
+  ghosts_init();
+  list_reset(&q_am);
+  list_reset(&q_a1in);
+  glist_reset(&q_a1out);
+}
+
+/* apply a deferred hit */
+static void q_touch(int slot){
+  /* hits in A1in are deliberately ignored */
+  if(lowner[slot] == &q_am){
+    list_remove(slot);
+    list_push(&q_am, slot);
+  }
+}
+
+static void q_fill(int slot, int file_id, int block_num){
+  pthread_mutex_lock(&policy_lock);
+  hits_drain(q_touch);
+  list_remove(slot);
+  pfile[slot] = file_id;
+  pblock[slot] = block_num;
+
+  int g = ghost_find(file_id, block_num);
+  if((g != -1) && (ghosts[g].owner == &q_a1out)){
+    ghost_remove(g);
+    list_push(&q_am, slot);
+  } else {
+    list_push(&q_a1in, slot);
+  }
+  pthread_mutex_unlock(&policy_lock);
+}
+
+static int q_victim(int file_id, int block_num){
+  int slot = -1;
+
+  pthread_mutex_lock(&policy_lock);
+  hits_drain(q_touch);
+  if((q_a1in.len > Q_KIN) || (q_am.len == 0)){
+    slot = list_pick(&q_a1in);
+    if(slot != -1){
+      while(q_a1out.len >= Q_KOUT)
+        ghost_pop(&q_a1out);
+      ghost_push(&q_a1out, pfile[slot], pblock[slot]);
+    }
+  }
+  if(slot == -1)
+    slot = list_pick(&q_am);
+  pthread_mutex_unlock(&policy_lock);
+
+  return slot;
+}
+
+struct policy q_policy = {
+  "2q", q_init, list_hit, q_fill, q_victim, list_forget
+};
+
+/* ================================================================
+ * ARC (Megiddo and Modha): T1 holds blocks seen once recently, T2
+ * blocks seen at least twice; B1 and B2 remember what was evicted from
+ * each. A miss that hits a ghost moves the target size p of T1 towards
+ * the list that would have kept the block.
+ * ================================================================
+ */
+struct slist arc_t1;
+struct slist arc_t2;
+struct glist arc_b1;
+struct glist arc_b2;
+int arc_p;
+
+
+static void arc_init(int n){
+  slots_alloc(n);
+  lists_init();
+  ghosts_init();
+  list_reset(&arc_t1);
+  list_reset(&arc_t2);
+  glist_reset(&arc_b1);
+  glist_reset(&arc_b2);
+  arc_p = 0;
+
+  for(int i = 0; i < nslots; i++)
+    arc_target[i] = NULL;
+}
+
+/* the target size of T1 after a reference to ghost g (-1 for none),
+ * without changing anything. Call with policy_lock held. */
+static int arc_adapted_p(int g){
+  if(g == -1)
+    return arc_p;
+
+  if(ghosts[g].owner == &arc_b1){
+    int delta = arc_b1.len >= arc_b2.len ? 1 : arc_b2.len / arc_b1.len;
+    return arc_p + delta < nslots ? arc_p + delta : nslots;
+  } else {
+    int delta = arc_b2.len >= arc_b1.len ? 1 : arc_b1.len / arc_b2.len;
+    return arc_p - delta > 0 ? arc_p - delta : 0;
+  }
+}
+
+/* adapt p for a reference to ghost g and forget it; return the list the
+ * block is to be filled into. Call with policy_lock held. */
+static struct slist *arc_classify(int g){
+  arc_p = arc_adapted_p(g);
+  if(g == -1)
+    return &arc_t1;
+
+  ghost_remove(g);
+  return &arc_t2;
+}
+
+/* apply a deferred hit */
+static void arc_touch(int slot){
+  if((lowner[slot] == &arc_t1) || (lowner[slot] == &arc_t2)){
+    list_remove(slot);
+    list_push(&arc_t2, slot);
+  }
+}
+
+static void arc_fill(int slot, int file_id, int block_num){
+  pthread_mutex_lock(&policy_lock);
+  hits_drain(arc_touch);
+  list_remove(slot);
+  pfile[slot] = file_id;
+  pblock[slot] = block_num;
+
+  struct slist *target = arc_target[slot];
+  arc_target[slot] = NULL;
+  if(target == NULL)
+    target = arc_classify(ghost_find(file_id, block_num));
+
+  if(target == &arc_t1){
+    /* a brand new block: keep |T1|+|B1| <= c and the directory <= 2c */
+    while((arc_t1.len + arc_b1.len >= nslots) && (arc_b1.len > 0))
+      ghost_pop(&arc_b1);
+    while((arc_t1.len + arc_t2.len + arc_b1.len + arc_b2.len >= 2 * nslots) &&
+        (arc_b2.len > 0))
+      ghost_pop(&arc_b2);
+  }
+  list_push(target, slot);
+  pthread_mutex_unlock(&policy_lock);
+}
+
+static int arc_victim(int file_id, int block_num){
+  int slot;
+
+  pthread_mutex_lock(&policy_lock);
+  hits_drain(arc_touch);
+  int g = ghost_find(file_id, block_num);
+  int in_b2 = (g != -1) && (ghosts[g].owner == &arc_b2);
+  int p = arc_adapted_p(g);
+  struct glist *evicted = &arc_b1;
+
+  /* REPLACE(x, p), with p as it will be once the miss is classified */
+  if((arc_t1.len > 0) &&
+      ((arc_t1.len > p) || (in_b2 && (arc_t1.len == p)))){
+    slot = list_pick(&arc_t1);
+  } else if((slot = list_pick(&arc_t2)) != -1){
+    evicted = &arc_b2;
+  } else {
+    slot = list_pick(&arc_t1);
+  }
+
+  /* Only a miss that gets a slot consumes its ghost and moves p; one
+   * that finds every slot being refilled retries with both intact.
+   * The ghost is removed before the victim's is pushed, so the push
+   * cannot recycle it. */
+  if(slot != -1){
+    arc_target[slot] = arc_classify(g);
+    ghost_push(evicted, pfile[slot], pblock[slot]);
+  }
+  pthread_mutex_unlock(&policy_lock);
+
+  return slot;
+}
+
+struct policy arc_policy = {
+  "arc", arc_init, list_hit, arc_fill, arc_victim, list_forget
+};
+
+struct policy *policies[] = {
+  &random_policy, &lru_policy, &clock_policy, &q_policy, &arc_policy, NULL
+};
+
+/* return the policy called name, NULL if there is none */
+struct policy *find_policy(const char *name){
+  for(int i = 0; policies[i] != NULL; i++){
+    if(strcmp(policies[i]->name, name) == 0)
+      return policies[i];
+  }
+  return NULL;
+}
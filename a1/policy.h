@@ -0,0 +1,53 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+/* Cache replacement policy interface.
+ *
+ * The cache tells the policy about every block it loads (fill) and every
+ * hit on a resident block (hit). When no empty slot is left it asks the
+ * policy for a victim, passing the block it is about to load so that
+ * policies with history (2Q, ARC) can adapt. A slot returned by victim
+ * is taken out of the policy's bookkeeping until it is filled again, so
+ * two concurrent misses are never handed the same slot. victim returns
+ * -1 if every slot is currently being refilled.
+ *
+ * When a block is invalidated the cache asks the policy to forget its
+ * slot, which is then put on the free list. forget returns 0 if the
+ * slot is not the policy's to give up (it has just been handed out as
+ * a victim and the thread that got it will refill it), 1 otherwise.
+ * Forgotten blocks leave no ghost behind.
+ *
+ * fill is called with the slot's lock held. hit is not: read hits take
+ * no lock, so hit may arrive for a slot that has just been handed out
+ * as a victim or refilled, and must leave such a slot alone or treat
+ * it as a harmless hint. hit must not take a lock either; the list
+ * policies record the hit and reorder their lists at the next victim
+ * or fill.
+ *
+ * While prefer_clean is set (the background flusher is running) victim
+ * should pass over dirty slots when a clean one is nearly as good, so
+ * that a miss does not also wait for a write-back. slot_is_clean is a
+ * lock-free hint provided by the cache. The prefetch threads set their
+ * own prefetching flag, which victim treats the same way, so that
+ * read-ahead displaces clean blocks rather than dirty ones.
+ */
+struct policy {
+  const char *name;
+  void (*init)(int nslots);
+  void (*hit)(int slot);
+  void (*fill)(int slot, int file_id, int block_num);
+  int (*victim)(int file_id, int block_num);
+  int (*forget)(int slot);
+};
+
+extern int prefer_clean;
+extern __thread int prefetching;
+int slot_is_clean(int slot);
+
+/* NULL terminated list of the available policies */
+extern struct policy *policies[];
+
+struct policy *find_policy(const char *name);
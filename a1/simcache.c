@@ -7,88 +7,523 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
-#include <time.h>
+#include <string.h>
+#include <unistd.h>
 #include <pthread.h>
 #include "common.h"
+#include "simtime.h"
 #include "rv.h"
+#include "policy.h"
+#include "trace.h"
+#include "hist.h"
 
 void compute(int min_time, int max_time) {
 	long sleep_time = Equilikely(min_time, max_time);
-	struct timespec t;
-	t.tv_sec = 0;
-	t.tv_nsec = sleep_time * 1000000;
-	if(nanosleep(&t, NULL) == -1) {
-		perror("nanosleep");
-	}
+	sim_sleep(sleep_time);
 }
 
-/* array to store read/write stats */
-int io_stats[NUM_PROCESSES][3];
+/* Workload parameters, from the command line */
+int opt_procs = NUM_PROCESSES;
+int opt_files = NUM_FILES;
+double opt_read_prob = READ_PROB;
+int opt_virtual = 0;
+int opt_passes = 1;       /* times each process reads its file */
+int opt_no_delay = 0;     /* no compute or memory time, for throughput */
+int opt_unlink = 0;       /* processes delete their file when done */
+
+/* trace being replayed instead of the synthetic workload, if any, and
+ * how to scale its timestamps (0 replays as fast as possible) */
+struct trace *replay = NULL;
+double replay_scale = 0;
+
+/* size of a cache line, to keep each thread's statistics apart */
+#define CACHE_LINE 64
+
+/* Everything one thread measures. Each block starts on a cache line of
+ * its own, so threads updating their counts never write to the same
+ * line.
+ */
+struct thread_stats {
+  long count[3];            /* by read_block's result: miss, hit, invalid */
+  struct hist lat[2][2];    /* latency by [write][hit], ms of simulation time */
+} __attribute__((aligned(CACHE_LINE)));
+
+struct thread_stats *stats;
+
+/* the file each process works on; chosen before the threads start so
+ * that every policy replays the same workload */
+int *proc_file;
+
+/* latency summaries kept per run, see struct result */
+#define LAT_ALL 0
+#define LAT_HITS 1
+#define LAT_MISSES 2
+
+#define LAT_MEAN 0
+#define LAT_P50 1
+#define LAT_P99 2
+#define LAT_P999 3
+
+/* what one run of the simulation measured */
+struct result {
+  int nthreads;
+  long accesses;
+  double hit_ratio;
+  double elapsed;     /* length of the run in simulation time, ms */
+  double throughput;  /* accesses per second of simulation time */
+  long pf_issued;     /* blocks read ahead, see cache_prefetch_stats */
+  long pf_used;
+  long pf_wasted;
+  long pf_unused;
+  double lat[3][4];   /* [LAT_ALL..LAT_MISSES][LAT_MEAN..LAT_P999], ms */
+};
+
+/* do one access for thread pid and update its statistics */
+void do_access(int pid, int fileid, int block, int write) {
+  struct thread_stats *s = &stats[pid];
+
+  trace_record(pid, fileid, block, write ? 'W' : 'R');
+
+  double start = sim_now();
+  int ret = write ? write_block(pid, fileid, block) : read_block(pid, fileid, block);
+  double lat = sim_now() - start;
+
+  s->count[ret]++;
+  if(ret != 2)
+    hist_add(&s->lat[write][ret], lat);
+}
 
 void *process(void *arg) {
 	int pid = (long)arg;
 
 	// choose a file 
-	int fileid = random() % NUM_FILES;
+	int fileid = proc_file[pid];
 	int size = get_file_size(fileid);
 	printf("[%d] starting, file %d, size %d\n", pid, fileid, size);
 
-  // initialize IO statistics
-  io_stats[pid][0] = io_stats[pid][1] = io_stats[pid][2] = 0; 
-
-	// access each block of the file sequentially
-	int i;
-	for(i = 0; i < size; i++) {
-		// processing time
-		compute(MIN_COMPUTE_TIME, MAX_COMPUTE_TIME);
-		// do the file read or write
-		if(random() / (double)INT32_MAX < READ_PROB) {
-			io_stats[pid][read_block(pid, fileid, i)]++;
-		} else {
-			io_stats[pid][write_block(pid, fileid, i)]++;
+	// access each block of the file sequentially, opt_passes times
+	int i, pass;
+	for(pass = 0; pass < opt_passes; pass++) {
+		for(i = 0; i < size; i++) {
+			// processing time
+			if(!opt_no_delay)
+				compute(MIN_COMPUTE_TIME, MAX_COMPUTE_TIME);
+			// do the file read or write; random() takes a lock, so
+			// only draw when there can be writes
+			do_access(pid, fileid, i, (opt_read_prob < 1) &&
+					(random() / (double)INT32_MAX >= opt_read_prob));
 		}
 	}
 
+	// drop the file's blocks from the cache, as if it were deleted
+	if(opt_unlink)
+		invalidate_file(pid, fileid);
+
 	printf("[%d] terminating\n", pid);
+  sim_thread_exit();
   pthread_exit(NULL);
 }
 
-/* declare function to free up lists */
-void destroy_file_table();
+/* the time replay threads measure their trace timestamps from */
+double replay_start;
+
+/* Replay thread pid's records from the trace, waiting until each one is
+ * due unless replaying as fast as possible.
+ */
+void *replay_process(void *arg) {
+  int pid = (long)arg;
+  int first = replay->first[pid], last = replay->first[pid + 1];
+
+  for(int i = first; i < last; i++){
+    struct trace_rec *r = &replay->recs[i];
+
+    if(replay_scale > 0)
+      sim_sleep(replay_start + r->time * replay_scale - sim_now());
+
+    do_access(pid, r->file_id, r->block_num, r->op == 'W');
+  }
+
+  sim_thread_exit();
+  pthread_exit(NULL);
+}
+
+/* Run the whole simulation once with the given replacement policy,
+ * with the flusher off if flush_ratio is negative.
+ */
+struct result run(const char *policy, double flush_ratio, unsigned int seed) {
+  int nthreads = replay != NULL ? replay->nthreads : opt_procs;
+
+  void *mem;
+  if(posix_memalign(&mem, CACHE_LINE, nthreads * sizeof(struct thread_stats)) != 0)
+    mem = NULL;
+  stats = mem;
+  proc_file = malloc(nthreads * sizeof(int));
+  pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+  if(!stats || !proc_file || !threads){
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+
+  for(int i=0; i<nthreads; i++){
+    stats[i].count[0] = stats[i].count[1] = stats[i].count[2] = 0;
+    for(int w=0; w<2; w++){
+      hist_init(&stats[i].lat[w][0]);
+      hist_init(&stats[i].lat[w][1]);
+    }
+  }
 
-int main(int argc, char **argv){
   /* Initialize all structures */
-  build_file_table();
+  srandom(seed);
+  sim_init(opt_virtual);
+  if(replay != NULL)
+    set_file_table(replay->file_sizes, replay->nfiles);
+  else
+    build_file_table(opt_files);
+  set_policy(policy);
+  set_flusher(flush_ratio);
   init_cache();
 
-  pthread_t threads[NUM_PROCESSES];
+  for(int i=0; i<nthreads; i++)
+    proc_file[i] = random() % get_num_files();
 
-  for(int i=0; i<NUM_PROCESSES; i++){
-    if(pthread_create(&threads[i], NULL, process, (void *)i) != 0){
+  if(flush_ratio < 0)
+    printf("\nPolicy %s, flusher off:\n", policy);
+  else
+    printf("\nPolicy %s, flusher at %.2f dirty:\n", policy, flush_ratio);
+
+  /* count every thread in before any starts, so that in virtual time
+   * the clock waits for all of them */
+  sim_thread_add(nthreads);
+  replay_start = sim_now();
+  trace_begin();
+  for(int i=0; i<nthreads; i++){
+    if(pthread_create(&threads[i], NULL, replay != NULL ? replay_process : process,
+          (void *)(long)i) != 0){
       fprintf(stderr, "Error creating thread\n");
       exit(1);
     }
   }
 
   void *status;
-  for(int i=0; i<NUM_PROCESSES; i++){
+  for(int i=0; i<nthreads; i++){
     pthread_join(threads[i], &status);
   }
+  double elapsed = sim_now() - replay_start;
 
-  double ratio, total_hits=0, total=0;
+  double ratio;
+  long total_hits=0, total=0;
   printf("\nStatistics:\n");
-  for(int i=0; i<NUM_PROCESSES; i++){
-    ratio = (double)(io_stats[i][1])/
-      (io_stats[i][0] + io_stats[i][1] + io_stats[i][2]);
+  for(int i=0; i<nthreads; i++){
+    long *count = stats[i].count;
+    ratio = (double)count[1]/(count[0] + count[1] + count[2]);
 
-    total_hits += io_stats[i][1];
-    total += io_stats[i][0] + io_stats[i][1] + io_stats[i][2];
+    total_hits += count[1];
+    total += count[0] + count[1] + count[2];
 
-    printf("Thread %d, hits: %lf%% (%d)\n",
-        i, ratio*100, io_stats[i][1]);
+    printf("Thread %d, hits: %lf%% (%ld)\n", i, ratio*100, count[1]);
   }
   printf("Total hits: %lf%%\n", (double)total_hits/total*100);
 
-  destroy_file_table();
+  long reads, writes, shared;
+  cache_io_stats(&reads, &writes, &shared);
+  printf("Disk reads: %ld, writes: %ld, misses sharing a fetch: %ld\n",
+      reads, writes, shared);
+
+  long dropped, reused;
+  cache_free_stats(&dropped, &reused);
+  printf("Blocks invalidated: %ld, misses filling a free slot: %ld\n",
+      dropped, reused);
+
+  long issued, used, wasted, unused;
+  cache_prefetch_stats(&issued, &used, &wasted, &unused);
+  if(issued > 0)
+    printf("Blocks prefetched: %ld, used: %ld, evicted unused: %ld, "
+        "never used: %ld\n", issued, used, wasted, unused);
+
+  destroy_cache();
+
+  /* merge the threads' histograms: by op and result, and overall */
+  static struct hist merged[2][2], all, hits, misses;
+  hist_init(&all);
+  hist_init(&hits);
+  hist_init(&misses);
+  for(int w=0; w<2; w++){
+    for(int h=0; h<2; h++){
+      hist_init(&merged[w][h]);
+      for(int i=0; i<nthreads; i++)
+        hist_merge(&merged[w][h], &stats[i].lat[w][h]);
+      hist_merge(&all, &merged[w][h]);
+      hist_merge(h ? &hits : &misses, &merged[w][h]);
+    }
+  }
+
+  struct result r;
+  r.nthreads = nthreads;
+  r.accesses = total;
+  r.hit_ratio = (double)total_hits/total;
+  r.elapsed = elapsed;
+  r.throughput = elapsed > 0 ? total / (elapsed / 1000) : 0;
+  r.pf_issued = issued;
+  r.pf_used = used;
+  r.pf_wasted = wasted;
+  r.pf_unused = unused;
+
+  const struct hist *summary[3] = { &all, &hits, &misses };
+  for(int k=0; k<3; k++){
+    r.lat[k][LAT_MEAN] = hist_mean(summary[k]);
+    r.lat[k][LAT_P50] = hist_quantile(summary[k], 0.5);
+    r.lat[k][LAT_P99] = hist_quantile(summary[k], 0.99);
+    r.lat[k][LAT_P999] = hist_quantile(summary[k], 0.999);
+  }
+
+  free(stats);
+  free(proc_file);
+  free(threads);
+
+  printf("%s time: %.3f s\n", opt_virtual ? "Simulated" : "Elapsed",
+      r.elapsed / 1000);
+  printf("Throughput: %.1f accesses/s\n", r.throughput);
+
+  const char *names[] = { "read misses", "read hits", "write misses",
+    "write hits", "all misses", "all hits", "all" };
+  const struct hist *rows[] = { &merged[0][0], &merged[0][1], &merged[1][0],
+    &merged[1][1], &misses, &hits, &all };
+  printf("%-14s %8s %10s %10s %10s %10s\n",
+      "Latency (ms)", "count", "mean", "p50", "p99", "p99.9");
+  for(int k=0; k<7; k++){
+    printf("%-14s %8ld %10.4f %10.4f %10.4f %10.4f\n", names[k], rows[k]->n,
+        hist_mean(rows[k]), hist_quantile(rows[k], 0.5),
+        hist_quantile(rows[k], 0.99), hist_quantile(rows[k], 0.999));
+  }
+  return r;
+}
+
+/* describe a flusher setting for the summary table and CSV */
+void flusher_name(char *buf, size_t len, double ratio) {
+  if(ratio < 0)
+    snprintf(buf, len, "off");
+  else
+    snprintf(buf, len, "%.2f", ratio);
+}
+
+void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-p policy] [-s seed] [-n slots] [-P processes] "
+      "[-N files] [-r read_prob] [-V]\n"
+      "         [-i passes] [-Z] [-L] [-u]\n"
+      "         [-c channels] [-q depth] [-d disk_ms] [-f ratio [-F]] [-k blocks]\n"
+      "         [-t trace [-x scale]] [-o trace] [-C csv]\n", prog);
+  fprintf(stderr, "  policy: all");
+  for(int i=0; policies[i] != NULL; i++)
+    fprintf(stderr, ", %s", policies[i]->name);
+  fprintf(stderr, " (default random)\n");
+  fprintf(stderr, "  slots, processes, files, read_prob: default %d, %d, %d, %.2f\n",
+      NUM_SLOTS, NUM_PROCESSES, NUM_FILES, READ_PROB);
+  fprintf(stderr, "  -V: run in virtual time; delays advance a simulated clock instead\n"
+      "      of sleeping, and latencies are reported in simulated time\n");
+  fprintf(stderr, "  passes: times each process reads its file (default 1)\n");
+  fprintf(stderr, "  -Z: no compute or memory time, to measure throughput\n");
+  fprintf(stderr, "  -u: each process deletes its file from the cache when done\n");
+  fprintf(stderr, "  -L: lock the slot on read hits instead of validating it\n");
+  fprintf(stderr, "  channels: requests the disk serves in parallel (default 1)\n");
+  fprintf(stderr, "  depth: most requests queued or in service (default 32)\n");
+  fprintf(stderr, "  disk_ms: time per transfer (default %d)\n", DISK_TIME);
+  fprintf(stderr, "  ratio: run the flusher once this fraction of slots is dirty\n");
+  fprintf(stderr, "  blocks: read this many blocks ahead of sequential streams\n");
+  fprintf(stderr, "  -F: run every policy both with and without the flusher\n");
+  fprintf(stderr, "  -t: replay a recorded trace instead of the synthetic workload,\n"
+      "      with timestamps multiplied by scale (default 0, as fast as possible)\n");
+  fprintf(stderr, "  -o: record the accesses of a single run into a trace\n");
+  fprintf(stderr, "  -C: append one line of results per run to a CSV file\n");
+  exit(1);
+}
+
+int main(int argc, char **argv){
+  const char *policy = "random";
+  unsigned int seed = 1;
+  int slots = NUM_SLOTS;
+  int channels = 1, depth = 32, disk_ms = DISK_TIME;
+  double flush_ratio = -1;
+  int compare = 0;
+  const char *trace_in = NULL, *trace_path = NULL, *csv_path = NULL;
+  int locked = 0, prefetch = 0;
+  int opt;
+
+  while((opt = getopt(argc, argv, "p:s:n:P:N:r:Vi:ZLuc:q:d:f:Fk:t:x:o:C:")) != -1){
+    switch(opt){
+      case 'p':
+        policy = optarg;
+        if(strcmp(policy, "all") != 0 && find_policy(policy) == NULL)
+          usage(argv[0]);
+        break;
+      case 's':
+        seed = strtoul(optarg, NULL, 0);
+        break;
+      case 'n':
+        slots = atoi(optarg);
+        break;
+      case 'P':
+        opt_procs = atoi(optarg);
+        break;
+      case 'N':
+        opt_files = atoi(optarg);
+        break;
+      case 'r':
+        opt_read_prob = atof(optarg);
+        break;
+      case 'V':
+        opt_virtual = 1;
+        break;
+      case 'i':
+        opt_passes = atoi(optarg);
+        break;
+      case 'Z':
+        opt_no_delay = 1;
+        break;
+      case 'L':
+        locked = 1;
+        break;
+      case 'u':
+        opt_unlink = 1;
+        break;
+      case 'c':
+        channels = atoi(optarg);
+        break;
+      case 'q':
+        depth = atoi(optarg);
+        break;
+      case 'd':
+        disk_ms = atoi(optarg);
+        break;
+      case 'f':
+        flush_ratio = atof(optarg);
+        break;
+      case 'F':
+        compare = 1;
+        break;
+      case 'k':
+        prefetch = atoi(optarg);
+        break;
+      case 't':
+        trace_in = optarg;
+        break;
+      case 'x':
+        replay_scale = atof(optarg);
+        break;
+      case 'o':
+        trace_path = optarg;
+        break;
+      case 'C':
+        csv_path = optarg;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  if(slots < 1 || opt_procs < 1 || opt_passes < 1 || opt_files < 1 ||
+      opt_read_prob < 0 || opt_read_prob > 1 || channels < 1 || depth < 1 ||
+      disk_ms < 0 || prefetch < 0 || flush_ratio > 1 ||
+      (compare && flush_ratio < 0) || replay_scale < 0)
+    usage(argv[0]);
+  set_cache_size(slots);
+  if(opt_no_delay)
+    set_mem_time(0);
+  set_locked_hits(locked);
+  set_prefetch(prefetch);
+  set_disk(channels, depth, disk_ms);
+
+  struct trace t;
+  if(trace_in != NULL){
+    if(trace_load(trace_in, &t) != 0)
+      exit(1);
+    replay = &t;
+  }
+
+  /* the policies and flusher settings to run, all with the same seed so
+   * that they see the same files */
+  const char *names[16];
+  int npolicies = 0;
+  if(strcmp(policy, "all") == 0){
+    for(; policies[npolicies] != NULL; npolicies++)
+      names[npolicies] = policies[npolicies]->name;
+  } else {
+    names[npolicies++] = policy;
+  }
+
+  double ratios[2] = { compare ? -1 : flush_ratio, flush_ratio };
+  int nratios = compare ? 2 : 1;
+
+  if(trace_path != NULL){
+    /* a trace holds exactly one run */
+    if(npolicies * nratios > 1)
+      usage(argv[0]);
+    if(trace_open(trace_path) != 0)
+      exit(1);
+  }
+
+  FILE *csv = NULL;
+  if(csv_path != NULL){
+    csv = fopen(csv_path, "a");
+    if(csv == NULL){
+      perror(csv_path);
+      exit(1);
+    }
+    /* a new file gets a header, an existing one more rows */
+    if(ftell(csv) == 0)
+      fprintf(csv, "policy,flusher,slots,processes,files,read_prob,passes,"
+          "channels,depth,disk_ms,virtual,locked_hits,prefetch,seed,accesses,"
+          "hit_ratio,elapsed_s,ops_per_s,prefetched,prefetch_used,"
+          "prefetch_wasted,prefetch_unused,mean_ms,p50_ms,p99_ms,p999_ms,"
+          "hit_mean_ms,hit_p50_ms,hit_p99_ms,hit_p999_ms,"
+          "miss_mean_ms,miss_p50_ms,miss_p99_ms,miss_p999_ms\n");
+  }
+
+  struct result results[16][2];
+  for(int i=0; i<npolicies; i++){
+    for(int j=0; j<nratios; j++){
+      struct result *r = &results[i][j];
+      *r = run(names[i], ratios[j], seed);
+
+      if(csv != NULL){
+        char flusher[16];
+        flusher_name(flusher, sizeof(flusher), ratios[j]);
+        fprintf(csv, "%s,%s,%d,%d,%d,%g,%d,%d,%d,%d,%d,%d,%d,%u,%ld,%.6f,"
+            "%.6f,%.1f,%ld,%ld,%ld,%ld",
+            names[i], flusher, slots, r->nthreads,
+            replay != NULL ? replay->nfiles : opt_files, opt_read_prob,
+            opt_passes, channels, depth, disk_ms, opt_virtual, locked,
+            prefetch, seed, r->accesses, r->hit_ratio, r->elapsed / 1000,
+            r->throughput, r->pf_issued, r->pf_used, r->pf_wasted,
+            r->pf_unused);
+        for(int k=LAT_ALL; k<=LAT_MISSES; k++)
+          for(int q=LAT_MEAN; q<=LAT_P999; q++)
+            fprintf(csv, ",%.4f", r->lat[k][q]);
+        fprintf(csv, "\n");
+      }
+    }
+  }
+  if(csv != NULL)
+    fclose(csv);
+
+  trace_close();
+  if(replay != NULL)
+    trace_free(replay);
+
+  if(npolicies * nratios > 1){
+    printf("\n%-8s %-8s %8s %12s %12s %12s %12s %12s\n", "policy",
+        "flusher", "hits", "ops/s", "p50", "p99", "p99.9", "time");
+    for(int i=0; i<npolicies; i++){
+      for(int j=0; j<nratios; j++){
+        struct result *r = &results[i][j];
+        char flusher[16];
+        flusher_name(flusher, sizeof(flusher), ratios[j]);
+        printf("%-8s %-8s %7.2f%% %12.1f %9.1f ms %9.1f ms %9.1f ms %10.3f s\n",
+            names[i], flusher, r->hit_ratio*100, r->throughput,
+            r->lat[LAT_ALL][LAT_P50], r->lat[LAT_ALL][LAT_P99],
+            r->lat[LAT_ALL][LAT_P999], r->elapsed / 1000);
+      }
+    }
+  }
+
   pthread_exit(NULL);
 }
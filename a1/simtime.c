@@ -0,0 +1,272 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "simtime.h"
+
+/* set by sim_init before any simulated thread starts */
+int virtual_time = 0;
+
+/* protects the virtual clock and everything below */
+pthread_mutex_t clock_lock = PTHREAD_MUTEX_INITIALIZER;
+
+double clock_now;         /* virtual time in milliseconds */
+int runnable;             /* simulated threads not blocked in sim_* */
+
+/* A thread in sim_sleep. Entries live on the sleeping thread's stack,
+ * in a list sorted by wakeup time (ties in arrival order).
+ */
+struct sleeper {
+  double wake;
+  int done;
+  pthread_cond_t cv;
+  struct sleeper *next;
+};
+
+struct sleeper *sleepers;
+
+/* If every simulated thread is blocked, move the clock to the earliest
+ * wakeup and make the threads due then runnable. Call with clock_lock
+ * held.
+ */
+static void advance() {
+  if((runnable > 0) || (sleepers == NULL))
+    return;
+
+  clock_now = sleepers->wake;
+  while((sleepers != NULL) && (sleepers->wake <= clock_now)){
+    struct sleeper *s = sleepers;
+    sleepers = s->next;
+    s->done = 1;
+    runnable++;
+    pthread_cond_signal(&s->cv);
+  }
+}
+
+/* the calling simulated thread is about to block */
+static void sim_block() {
+  pthread_mutex_lock(&clock_lock);
+  runnable--;
+  advance();
+  pthread_mutex_unlock(&clock_lock);
+}
+
+/* n blocked simulated threads are about to run again */
+static void sim_unblock(int n) {
+  pthread_mutex_lock(&clock_lock);
+  runnable += n;
+  pthread_mutex_unlock(&clock_lock);
+}
+
+/* Choose real (0) or virtual (1) time and reset the virtual clock to 0.
+ * Call while no simulated thread is running.
+ */
+void sim_init(int virtual) {
+  pthread_mutex_lock(&clock_lock);
+  virtual_time = virtual;
+  clock_now = 0;
+  runnable = 0;
+  sleepers = NULL;
+  pthread_mutex_unlock(&clock_lock);
+}
+
+int sim_is_virtual() {
+  return virtual_time;
+}
+
+/* the current time in milliseconds: monotonic, or virtual */
+double sim_now() {
+  if(virtual_time){
+    pthread_mutex_lock(&clock_lock);
+    double now = clock_now;
+    pthread_mutex_unlock(&clock_lock);
+    return now;
+  }
+
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+/* delay the calling thread by msec milliseconds */
+void sim_sleep(double msec) {
+  if(msec <= 0)
+    return;
+
+  if(!virtual_time){
+    struct timespec t;
+    t.tv_sec = msec / 1000;
+    t.tv_nsec = (msec - t.tv_sec * 1000.0) * 1000000.0;
+    if(nanosleep(&t, NULL) == -1)
+      perror("nanosleep");
+    return;
+  }
+
+  struct sleeper me;
+  me.done = 0;
+  if(pthread_cond_init(&me.cv, NULL) != 0){
+    fprintf(stderr, "Error Initializing Mutex\n");
+    exit(1);
+  }
+
+  pthread_mutex_lock(&clock_lock);
+  me.wake = clock_now + msec;
+  struct sleeper **link = &sleepers;
+  while((*link != NULL) && ((*link)->wake <= me.wake))
+    link = &(*link)->next;
+  me.next = *link;
+  *link = &me;
+
+  runnable--;
+  advance();
+  while(!me.done)
+    pthread_cond_wait(&me.cv, &clock_lock);
+  pthread_mutex_unlock(&clock_lock);
+
+  pthread_cond_destroy(&me.cv);
+}
+
+/* n simulated threads are about to be started; call before creating
+ * them so the clock does not run ahead of the ones not yet started */
+void sim_thread_add(int n) {
+  sim_unblock(n);
+}
+
+/* the calling simulated thread is done */
+void sim_thread_exit() {
+  sim_block();
+}
+
+void sim_cond_init(struct sim_cond *c) {
+  if(pthread_cond_init(&c->cv, NULL) != 0){
+    fprintf(stderr, "Error Initializing Mutex\n");
+    exit(1);
+  }
+  c->tickets = c->wakeups = 0;
+}
+
+void sim_cond_destroy(struct sim_cond *c) {
+  pthread_cond_destroy(&c->cv);
+}
+
+/* Wait on c, releasing m. In virtual time each waiter holds a ticket
+ * and only returns once a signal or broadcast has covered it, so a
+ * spurious wakeup cannot throw the count of runnable threads off.
+ */
+void sim_cond_wait(struct sim_cond *c, pthread_mutex_t *m) {
+  if(!virtual_time){
+    pthread_cond_wait(&c->cv, m);
+    return;
+  }
+
+  unsigned int ticket = c->tickets++;
+  sim_block();
+  while((int)(c->wakeups - ticket) <= 0)
+    pthread_cond_wait(&c->cv, m);
+}
+
+/* wake one waiter of c; call with its mutex held */
+void sim_cond_signal(struct sim_cond *c) {
+  if(!virtual_time){
+    pthread_cond_signal(&c->cv);
+    return;
+  }
+
+  if(c->wakeups != c->tickets){
+    c->wakeups++;
+    sim_unblock(1);
+    /* the oldest ticket must be the one to go */
+    pthread_cond_broadcast(&c->cv);
+  }
+}
+
+/* wake every waiter of c; call with its mutex held */
+void sim_cond_broadcast(struct sim_cond *c) {
+  if(!virtual_time){
+    pthread_cond_broadcast(&c->cv);
+    return;
+  }
+
+  int n = c->tickets - c->wakeups;
+  if(n > 0){
+    c->wakeups = c->tickets;
+    sim_unblock(n);
+    pthread_cond_broadcast(&c->cv);
+  }
+}
+
+void sim_lock_init(struct sim_lock *l) {
+  if(pthread_mutex_init(&l->m, NULL) != 0){
+    fprintf(stderr, "Error Initializing Mutex\n");
+    exit(1);
+  }
+  sim_cond_init(&l->cv);
+  l->held = 0;
+}
+
+void sim_lock_destroy(struct sim_lock *l) {
+  pthread_mutex_destroy(&l->m);
+  sim_cond_destroy(&l->cv);
+}
+
+/* In real time a sim_lock is just its mutex. In virtual time the mutex
+ * only guards the held flag, so that waiting for the lock is a
+ * sim_cond wait the clock knows about.
+ */
+void sim_lock_acquire(struct sim_lock *l) {
+  pthread_mutex_lock(&l->m);
+  if(!virtual_time)
+    return;
+
+  while(l->held)
+    sim_cond_wait(&l->cv, &l->m);
+  l->held = 1;
+  pthread_mutex_unlock(&l->m);
+}
+
+void sim_lock_release(struct sim_lock *l) {
+  if(!virtual_time){
+    pthread_mutex_unlock(&l->m);
+    return;
+  }
+
+  pthread_mutex_lock(&l->m);
+  l->held = 0;
+  sim_cond_signal(&l->cv);
+  pthread_mutex_unlock(&l->m);
+}
+
+/* wait on c, releasing l while waiting; call with l held */
+void sim_lock_wait(struct sim_cond *c, struct sim_lock *l) {
+  if(!virtual_time){
+    pthread_cond_wait(&c->cv, &l->m);
+    return;
+  }
+
+  pthread_mutex_lock(&l->m);
+  l->held = 0;
+  sim_cond_signal(&l->cv);
+  sim_cond_wait(c, &l->m);
+  while(l->held)
+    sim_cond_wait(&l->cv, &l->m);
+  l->held = 1;
+  pthread_mutex_unlock(&l->m);
+}
+
+/* wake every thread waiting on c under l; call with l held */
+void sim_lock_broadcast(struct sim_cond *c, struct sim_lock *l) {
+  if(!virtual_time){
+    pthread_cond_broadcast(&c->cv);
+    return;
+  }
+
+  pthread_mutex_lock(&l->m);
+  sim_cond_broadcast(c);
+  pthread_mutex_unlock(&l->m);
+}
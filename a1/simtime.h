@@ -0,0 +1,63 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+/* Simulation time.
+ *
+ * Every delay in the simulator (compute time, MEM_TIME, disk transfers)
+ * goes through sim_sleep, and every wait for another simulated thread
+ * goes through a sim_cond or sim_lock. In real time mode these are
+ * nanosleep and plain pthread mutexes and conditions. In virtual time
+ * mode no thread ever sleeps: the clock stands still while any
+ * simulated thread can run, and when all of them are blocked it jumps
+ * to the earliest pending wakeup. A run then takes as long as the
+ * bookkeeping does, not as long as the delays it models.
+ *
+ * For the clock to know when every thread is blocked:
+ *  - the creator of a simulated thread calls sim_thread_add before
+ *    starting it, and the thread calls sim_thread_exit when it is done;
+ *  - no plain mutex may be held across sim_sleep or a sim_cond wait
+ *    (other than the one the wait releases); use a sim_lock for locks
+ *    that are held across a delay;
+ *  - sim_cond_signal and sim_cond_broadcast are called with the
+ *    condition's mutex held.
+ */
+
+#include <pthread.h>
+
+struct sim_cond {
+  pthread_cond_t cv;
+  unsigned int tickets;     /* handed to waiters in arrival order */
+  unsigned int wakeups;     /* tickets below this one have been woken */
+};
+
+/* a mutex that may be held across a delay */
+struct sim_lock {
+  pthread_mutex_t m;
+  struct sim_cond cv;       /* virtual time: waiters for the lock */
+  int held;                 /* virtual time: the lock is taken */
+};
+
+void sim_init(int virtual_time);
+int sim_is_virtual();
+
+double sim_now();
+void sim_sleep(double msec);
+
+void sim_thread_add(int n);
+void sim_thread_exit();
+
+void sim_cond_init(struct sim_cond *c);
+void sim_cond_destroy(struct sim_cond *c);
+void sim_cond_wait(struct sim_cond *c, pthread_mutex_t *m);
+void sim_cond_signal(struct sim_cond *c);
+void sim_cond_broadcast(struct sim_cond *c);
+
+void sim_lock_init(struct sim_lock *l);
+void sim_lock_destroy(struct sim_lock *l);
+void sim_lock_acquire(struct sim_lock *l);
+void sim_lock_release(struct sim_lock *l);
+void sim_lock_wait(struct sim_cond *c, struct sim_lock *l);
+void sim_lock_broadcast(struct sim_cond *c, struct sim_lock *l);
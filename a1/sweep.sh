@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+
+# Sweep the cache size, number of processes and read probability in
+# virtual time, printing the total hit ratio and latency of every
+# combination and collecting every result in sweep.csv. Extra arguments
+# are passed on to simcache (e.g. -p lru).
+
+echo -e "Cache Parameter Sweep\n"
+
+make -s simcache
+rm -f sweep.csv
+
+for slots in 10 20 40 80
+do
+  for procs in 5 10 20 40
+  do
+    for read_prob in 0.5 0.7 0.9 1.0
+    do
+      echo "slots: ${slots}, processes: ${procs}, read_prob: ${read_prob}"
+      ./simcache -V -n ${slots} -P ${procs} -r ${read_prob} -C sweep.csv "$@" |
+        grep -e '^Total hits' -e '^Latency' -e '^all ' -e '^Simulated time'
+      echo ''
+    done
+  done
+done
@@ -0,0 +1,177 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common.h"
+#include "simtime.h"
+#include "trace.h"
+
+/* grow *array to hold at least n elements of size bytes each */
+static void *grow(void *array, int *cap, int n, size_t size) {
+  if(n <= *cap)
+    return array;
+
+  *cap = *cap > 0 ? *cap * 2 : 1024;
+  if(*cap < n)
+    *cap = n;
+  array = realloc(array, *cap * size);
+  if(array == NULL){
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  return array;
+}
+
+/* Read the trace in path into t. Returns 0 on success, -1 if the file
+ * cannot be read or is malformed (after printing why).
+ */
+int trace_load(const char *path, struct trace *t) {
+  FILE *f = fopen(path, "r");
+  if(f == NULL){
+    perror(path);
+    return -1;
+  }
+
+  struct trace_rec *recs = NULL;
+  int nrecs = 0, rec_cap = 0;
+  int *ids = NULL;                /* original id of each dense thread */
+  int nthreads = 0, id_cap = 0;
+  int *sizes = NULL;
+  int nfiles = 0, size_cap = 0;
+
+  char line[256];
+  int lineno = 0;
+  while(fgets(line, sizeof(line), f) != NULL){
+    lineno++;
+
+    char *p = line + strspn(line, " \t");
+    if((*p == '#') || (*p == '\n') || (*p == '\0'))
+      continue;
+
+    struct trace_rec r;
+    if((sscanf(p, "%d %d %d %c %lf", &r.thread, &r.file_id, &r.block_num,
+            &r.op, &r.time) != 5) || (r.file_id < 0) || (r.block_num < 0) ||
+        ((r.op != 'R') && (r.op != 'W'))){
+      fprintf(stderr, "%s:%d: malformed trace record\n", path, lineno);
+      fclose(f);
+      free(recs);
+      free(ids);
+      free(sizes);
+      return -1;
+    }
+
+    /* renumber the thread densely */
+    int tid = nthreads - 1;
+    while((tid >= 0) && (ids[tid] != r.thread))
+      tid--;
+    if(tid < 0){
+      ids = grow(ids, &id_cap, nthreads + 1, sizeof(int));
+      tid = nthreads++;
+      ids[tid] = r.thread;
+    }
+    r.thread = tid;
+
+    /* the file must be at least as large as any block accessed */
+    if(r.file_id >= nfiles){
+      sizes = grow(sizes, &size_cap, r.file_id + 1, sizeof(int));
+      while(nfiles <= r.file_id)
+        sizes[nfiles++] = 1;
+    }
+    if(r.block_num >= sizes[r.file_id])
+      sizes[r.file_id] = r.block_num + 1;
+
+    recs = grow(recs, &rec_cap, nrecs + 1, sizeof(struct trace_rec));
+    recs[nrecs++] = r;
+  }
+  fclose(f);
+  free(ids);
+
+  if(nrecs == 0){
+    fprintf(stderr, "%s: empty trace\n", path);
+    free(recs);
+    free(sizes);
+    return -1;
+  }
+
+  /* group the records by thread, keeping each thread's own order */
+  t->first = calloc(nthreads + 1, sizeof(int));
+  t->recs = malloc(nrecs * sizeof(struct trace_rec));
+  if((t->first == NULL) || (t->recs == NULL)){
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for(int i = 0; i < nrecs; i++)
+    t->first[recs[i].thread + 1]++;
+  for(int i = 0; i < nthreads; i++)
+    t->first[i + 1] += t->first[i];
+
+  int *next = malloc(nthreads * sizeof(int));
+  memcpy(next, t->first, nthreads * sizeof(int));
+  for(int i = 0; i < nrecs; i++)
+    t->recs[next[recs[i].thread]++] = recs[i];
+  free(next);
+  free(recs);
+
+  t->nrecs = nrecs;
+  t->nthreads = nthreads;
+  t->nfiles = nfiles;
+  t->file_sizes = sizes;
+  return 0;
+}
+
+void trace_free(struct trace *t) {
+  free(t->recs);
+  free(t->first);
+  free(t->file_sizes);
+}
+
+/* the trace being recorded, if any */
+FILE *trace_out = NULL;
+double trace_start;
+pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Start recording every access into path. Returns 0 on success, -1 if
+ * the file cannot be created. Times count from trace_begin().
+ */
+int trace_open(const char *path) {
+  trace_out = fopen(path, "w");
+  if(trace_out == NULL){
+    perror(path);
+    return -1;
+  }
+
+  fprintf(trace_out, "# thread file block op time_ms\n");
+  return 0;
+}
+
+/* Mark the start of the run: called once the clock is set up (in
+ * virtual time it starts at 0) and just before the threads start.
+ */
+void trace_begin() {
+  trace_start = sim_now();
+}
+
+/* Record one access, if recording; op is 'R' or 'W'. */
+void trace_record(int thread, int file_id, int block_num, char op) {
+  if(trace_out == NULL)
+    return;
+
+  /* timestamps are taken under the lock so the file stays in order */
+  pthread_mutex_lock(&trace_lock);
+  fprintf(trace_out, "%d %d %d %c %.3f\n", thread, file_id, block_num, op,
+      sim_now() - trace_start);
+  pthread_mutex_unlock(&trace_lock);
+}
+
+void trace_close() {
+  if(trace_out != NULL){
+    fclose(trace_out);
+    trace_out = NULL;
+  }
+}
@@ -0,0 +1,41 @@
+/*
+ * CSC 369 Fall 2010 - Assignment 1
+ *
+ * $Id$
+ */
+
+/* Block access traces.
+ *
+ * A trace is a text file with one access per line:
+ *
+ *     thread file block op time
+ *
+ * where op is R or W and time is milliseconds since the start of the
+ * run. Blank lines and lines starting with '#' are ignored. Thread ids
+ * need not be dense; they are renumbered in order of first appearance.
+ */
+
+struct trace_rec {
+  int thread;
+  int file_id;
+  int block_num;
+  char op;              /* 'R' or 'W' */
+  double time;          /* ms since the start of the run */
+};
+
+struct trace {
+  struct trace_rec *recs;   /* grouped by thread, in trace order */
+  int nrecs;
+  int nthreads;
+  int *first;               /* thread i owns recs[first[i]..first[i+1]) */
+  int nfiles;
+  int *file_sizes;          /* one past the highest block seen per file */
+};
+
+int trace_load(const char *path, struct trace *t);
+void trace_free(struct trace *t);
+
+int trace_open(const char *path);
+void trace_begin();
+void trace_record(int thread, int file_id, int block_num, char op);
+void trace_close();
@@ -0,0 +1,55 @@
+#!/usr/bin/env bash
+
+# Record a trace in virtual time, replay it in virtual time at scale 1
+# while recording again, and check that both traces have non-negative,
+# non-decreasing timestamps and that the replay kept the recorded pacing
+# (it ends no earlier than the original). Extra arguments are passed on
+# to the recording run (e.g. -p lru -P 20).
+
+make -s simcache
+
+rec=$(mktemp)
+rep=$(mktemp)
+trap 'rm -f ${rec} ${rep}' EXIT
+
+./simcache -V -o ${rec} "$@" > /dev/null || exit 1
+./simcache -V -t ${rec} -x 1 -o ${rep} > /dev/null || exit 1
+
+status=0
+for f in ${rec} ${rep}
+do
+  name=record
+  if [ ${f} = ${rep} ]
+  then
+    name=replay
+  fi
+
+  # prints the last timestamp, or fails on the first bad one
+  last=$(awk '
+    /^#/ || NF == 0 { next }
+    $5 < 0 { print "negative time on line " NR ": " $0 > "/dev/stderr"; bad = 1; exit 1 }
+    $5 < prev { print "time goes back on line " NR ": " $0 > "/dev/stderr"; bad = 1; exit 1 }
+    { prev = $5; n++ }
+    END {
+      if (bad) exit 1
+      if (n == 0) { print "empty trace" > "/dev/stderr"; exit 1 }
+      print prev
+    }
+  ' ${f}) || { echo "${name}: FAIL"; status=1; continue; }
+
+  echo "${name}: ok, $(grep -vc '^#' ${f}) accesses, last at ${last} ms"
+  eval ${name}_last=${last}
+done
+
+if [ ${status} = 0 ]
+then
+  if awk -v a=${record_last} -v b=${replay_last} 'BEGIN { exit !(b >= a) }'
+  then
+    echo "pacing: ok"
+  else
+    echo "pacing: FAIL, replay ended at ${replay_last} ms, record at ${record_last} ms"
+    status=1
+  fi
+fi
+
+exit ${status}
@@ -11,6 +11,71 @@
 /* Constant returned by a bunch of stdio functions on error */
 #define EOF (-1)
 
+/*
+ * Buffered streams.
+ *
+ * stdout is line buffered: output collects in a buffer and goes out
+ * in one write when a newline is printed, the buffer fills, input is
+ * read, or the program exits. If stdout turns out to be a regular
+ * file it is fully buffered instead. stderr is unbuffered, and so is stdin,
+ * so that a shell never reads input meant for the programs it runs.
+ * Streams from fopen are fully buffered.
+ *
+ * libc has no malloc, so fopen takes its streams and buffers from a
+ * static pool of FOPEN_MAX. The contents of FILE are private to libc.
+ */
+
+#define BUFSIZ  1024
+
+/* Buffering modes for setvbuf */
+#define _IOFBF  0	/* fully buffered */
+#define _IOLBF  1	/* line buffered */
+#define _IONBF  2	/* unbuffered */
+
+typedef struct __file {
+	int f_fd;
+	int f_flags;		/* __S* below; 0 if the slot is free */
+	int f_mode;		/* _IOFBF, _IOLBF or _IONBF */
+	char *f_buf;
+	size_t f_size;		/* 1 (f_ch) when unbuffered */
+	size_t f_pos;		/* bytes written, or next byte to read */
+	size_t f_len;		/* bytes in the buffer when reading */
+	char f_ch;
+	struct __file *f_next;	/* open streams, for fflush(NULL) */
+} FILE;
+
+#define __SRD   0x01	/* open for reading */
+#define __SWR   0x02	/* open for writing */
+#define __SEOF  0x04	/* hit end of file */
+#define __SERR  0x08	/* hit an error */
+#define __SRDING 0x10	/* buffer holds read-ahead */
+#define __SPROBE 0x20	/* check on first write whether output is a file */
+
+extern FILE *stdin;
+extern FILE *stdout;
+extern FILE *stderr;
+
+/* list of open streams (for libc internal use only) */
+extern FILE *__stdio_list;
+
+FILE *fopen(const char *path, const char *mode);
+FILE *fdopen(int fd, const char *mode);
+int fclose(FILE *f);
+int fflush(FILE *f);		/* NULL flushes every stream */
+int setvbuf(FILE *f, char *buf, int mode, size_t size);
+int fileno(FILE *f);
+int feof(FILE *f);
+int ferror(FILE *f);
+void clearerr(FILE *f);
+
+size_t fread(void *ptr, size_t size, size_t nmemb, FILE *f);
+size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *f);
+int fgetc(FILE *f);
+int fputc(int ch, FILE *f);
+int fputs(const char *s, FILE *f);
+int fprintf(FILE *f, const char *fmt, ...);
+int vfprintf(FILE *f, const char *fmt, __va_list ap);
+
 /*
  * The actual guts of printf
  * (for libc internal use only)
@@ -37,6 +102,7 @@ int __puts(const char *);
 int putchar(int);
 
 /* Reads one character (0-255) or returns EOF on error. */
+/* Flushes stdout first, so prompts appear before we wait. */
 int getchar(void);
 
 #endif /* _STDIO_H_ */
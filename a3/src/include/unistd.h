@@ -120,6 +120,14 @@ int dup2(int filehandle, int newhandle);
 int pipe(int filehandles[2]);
 time_t __time(time_t *seconds, unsigned long *nanoseconds);
 int __getcwd(char *buf, size_t buflen);
+pid_t __fork(void);
+int __execv(const char *prog, char *const *args);
+/*
+ * sendfile copies up to count bytes from infh to outfh inside the
+ * kernel, starting at and advancing both current offsets. It returns
+ * the number of bytes copied, or 0 at end of file.
+ */
+int sendfile(int outfh, int infh, size_t count);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
 
@@ -129,5 +137,6 @@ int __getcwd(char *buf, size_t buflen);
 
 char *getcwd(char *buf, size_t buflen);		/* calls __getcwd */
 time_t time(time_t *seconds);			/* calls __time */
+/* fork and execv, declared above, call __fork and __execv */
 
 #endif /* _UNISTD_H_ */
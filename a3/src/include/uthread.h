@@ -0,0 +1,95 @@
+#ifndef _UTHREAD_H_
+#define _UTHREAD_H_
+
+#include <sys/types.h>
+#include <unistd.h>
+
+/*
+ * User-level threads.
+ *
+ * All the threads of a process share its one kernel thread; libc
+ * switches between them with setjmp/longjmp, so creating a thread or
+ * switching to another never enters the kernel. Scheduling is
+ * cooperative: a thread runs until it yields, blocks on a mutex,
+ * condition variable or join, or exits. The threads that are ready
+ * run in FIFO order.
+ *
+ * main is thread 0 and runs on the process stack; the others get
+ * stacks of UTHREAD_STACKSIZE bytes from a static pool, so at most
+ * UTHREAD_MAX threads, counting main, exist at once. A thread exits
+ * by returning from its function or calling uthread_exit, and its
+ * slot is reclaimed when another thread joins it, or at exit if it
+ * has been detached. A thread that is neither joined nor detached
+ * keeps its slot for the life of the process. If main returns
+ * the whole process exits; if it calls uthread_exit instead, the
+ * process exits when the last thread does.
+ */
+
+#define UTHREAD_MAX        32
+#define UTHREAD_STACKSIZE  16384
+
+struct uthread;
+
+/* FIFO of threads waiting for something. */
+struct uthread_queue {
+	struct uthread *uq_head;
+	struct uthread *uq_tail;
+};
+
+struct uthread_mutex {
+	struct uthread *um_owner;
+	struct uthread_queue um_waiters;
+};
+
+struct uthread_cond {
+	struct uthread_queue uc_waiters;
+};
+
+#define UTHREAD_MUTEX_INITIALIZER  { NULL, { NULL, NULL } }
+#define UTHREAD_COND_INITIALIZER   { { NULL, NULL } }
+
+/*
+ * Create a thread running func(arg). Returns its id, or -1 with
+ * errno set to EAGAIN if UTHREAD_MAX threads already exist. The new
+ * thread does not run until the caller yields or blocks.
+ */
+int uthread_create(void (*func)(void *), void *arg);
+
+/* Id of the calling thread. */
+int uthread_self(void);
+
+/* Let the other ready threads run first. */
+void uthread_yield(void);
+
+/* End the calling thread. */
+__DEAD void uthread_exit(void);
+
+/*
+ * Wait for thread tid to exit and free its slot. Returns 0, or -1
+ * with errno set to ESRCH if there is no such thread or EINVAL if
+ * tid is the caller.
+ */
+int uthread_join(int tid);
+
+/*
+ * Let thread tid's slot be freed as soon as it exits, instead of
+ * by uthread_join; it can no longer be joined. Returns 0, or -1 with
+ * errno set to ESRCH if there is no such thread or EINVAL if tid is
+ * main, already detached, or being joined.
+ */
+int uthread_detach(int tid);
+
+/*
+ * Mutex and condition variable. Unlocking a mutex with waiters hands
+ * it straight to the first of them.
+ */
+void uthread_mutex_init(struct uthread_mutex *m);
+void uthread_mutex_lock(struct uthread_mutex *m);
+void uthread_mutex_unlock(struct uthread_mutex *m);
+
+void uthread_cond_init(struct uthread_cond *c);
+void uthread_cond_wait(struct uthread_cond *c, struct uthread_mutex *m);
+void uthread_cond_signal(struct uthread_cond *c);
+void uthread_cond_broadcast(struct uthread_cond *c);
+
+#endif /* _UTHREAD_H_ */
@@ -35,6 +35,10 @@ void coremap_unpin(paddr_t paddr);
 void coremap_zero_page(paddr_t paddr);
 void coremap_copy_page(paddr_t oldpaddr, paddr_t newpaddr);
 
+/* their unrolled inner loops, in page_mips1.S; addresses page-aligned */
+void mips_page_zero(vaddr_t page);
+void mips_page_copy(vaddr_t dst, vaddr_t src);
+
 /*
  * Routines for mapping physical pages into the kernel so the machine-
  * independent code can manipulate them. (This is for page content
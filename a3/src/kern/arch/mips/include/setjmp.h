@@ -7,6 +7,13 @@
  */
 #define __JB_REGS  11
 
+/*
+ * Where sp and ra live in a jmp_buf, for code that builds a context
+ * by hand to start on a fresh stack (user-level threads in libc).
+ */
+#define __JB_SP  0
+#define __JB_RA  1
+
 /* A jmp_buf is an array of __JB_REGS registers */
 typedef u_int32_t jmp_buf[__JB_REGS];
 
@@ -977,7 +977,7 @@ coremap_zero_page(paddr_t paddr)
 	assert(coremap_pageispinned(paddr));
 
 	va = PADDR_TO_KVADDR(paddr);
-	bzero((char *)va, PAGE_SIZE);
+	mips_page_zero(va);
 }
 
 /*
@@ -997,7 +997,7 @@ coremap_copy_page(paddr_t oldpaddr, paddr_t newpaddr)
 
 	oldva = PADDR_TO_KVADDR(oldpaddr);
 	newva = PADDR_TO_KVADDR(newpaddr);
-	memcpy((char *)newva, (char *)oldva, PAGE_SIZE);
+	mips_page_copy(newva, oldva);
 }
 
 ////////////////////////////////////////////////////////////
@@ -169,9 +169,17 @@ mips_syscall(struct trapframe *tf)
 	    case SYS_rmdir:
 		err = sys_rmdir((userptr_t)tf->tf_a0);
 		break;
+	    case SYS_sendfile:
+		err = sys_sendfile(tf->tf_a0, tf->tf_a1, tf->tf_a2, &retval);
+		break;
 	    
 	    // END A3 SETUP
 
+	    case SYS___time:
+		err = sys___time((userptr_t)tf->tf_a0, (userptr_t)tf->tf_a1,
+				 &retval);
+		break;
+
 	    default:
 		kprintf("Unknown syscall %d\n", callno);
 		err = ENOSYS;
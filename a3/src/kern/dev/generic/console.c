@@ -17,8 +17,12 @@
  * and (2) if the system crashes before we find a console, no output
  * at all may appear.
  *
- * Note that we have no input buffering; characters typed too rapidly
- * will be lost.
+ * Output is queued in a ring buffer (cs_obuf) that the device's
+ * write-done interrupt drains, so a writer only waits when the ring
+ * is full, and a user write is copied in with one uiomove per
+ * CON_OBUFSIZE/2 bytes rather than one per character. Input is
+ * queued the same way as it is typed, up to CON_IBUFSIZE characters;
+ * anything typed beyond that before it is read is lost.
  */
 
 #include <types.h>
@@ -26,6 +30,7 @@
 #include <lib.h>
 #include <machine/spl.h>
 #include <synch.h>
+#include <thread.h>
 #include <generic/console.h>
 #include <dev.h>
 #include <vfs.h>
@@ -81,15 +86,88 @@ flush_delay_buf(void)
 
 //////////////////////////////////////////////////
 
+/*
+ * Take the next character off the output ring, waking writers
+ * waiting for space if the ring was full. Called at splhigh.
+ */
+static
+int
+con_odequeue(struct con_softc *cs)
+{
+	int ch = cs->cs_obuf[cs->cs_ohead];
+
+	cs->cs_ohead = (cs->cs_ohead + 1) % CON_OBUFSIZE;
+	if (cs->cs_olen-- == CON_OBUFSIZE) {
+		thread_wakeup(&cs->cs_olen);
+	}
+	return ch;
+}
+
+/*
+ * If the device is idle, start it on the next character in the
+ * output ring. Called at splhigh.
+ */
+static
+void
+con_kick(struct con_softc *cs)
+{
+	if (!cs->cs_obusy && cs->cs_olen > 0) {
+		cs->cs_obusy = 1;
+		cs->cs_send(cs->cs_devdata, con_odequeue(cs));
+	}
+}
+
+/*
+ * Queue len characters for output, sleeping while the ring is full.
+ * With crlf set, each newline is preceded by a carriage return.
+ */
+static
+void
+con_enqueue(struct con_softc *cs, const char *data, size_t len, int crlf)
+{
+	unsigned tail;
+	int spl, cr = 0;
+
+	spl = splhigh();
+	while (len > 0) {
+		if (cs->cs_olen == CON_OBUFSIZE) {
+			con_kick(cs);
+			thread_sleep(&cs->cs_olen);
+			continue;
+		}
+
+		tail = (cs->cs_ohead + cs->cs_olen) % CON_OBUFSIZE;
+		if (crlf && *data == '\n' && !cr) {
+			cs->cs_obuf[tail] = '\r';
+			cr = 1;
+		}
+		else {
+			cs->cs_obuf[tail] = *data++;
+			len--;
+			cr = 0;
+		}
+		cs->cs_olen++;
+	}
+	con_kick(cs);
+	splx(spl);
+}
+
 /*
  * Print a character, using polling instead of interrupts to wait for
- * I/O completion.
+ * I/O completion. Whatever is still queued goes out first, so output
+ * stays in order (and a panic message follows what came before it).
  */
 static
 void
 putch_polled(struct con_softc *cs, int ch)
 {
+	int spl = splhigh();
+
+	while (cs->cs_olen > 0) {
+		cs->cs_sendpolled(cs->cs_devdata, con_odequeue(cs));
+	}
 	cs->cs_sendpolled(cs->cs_devdata, ch);
+	splx(spl);
 }
 
 //////////////////////////////////////////////////
@@ -102,8 +180,41 @@ static
 void
 putch_intr(struct con_softc *cs, int ch)
 {
-	P(cs->cs_wsem);
-	cs->cs_send(cs->cs_devdata, ch);
+	char c = ch;
+
+	con_enqueue(cs, &c, 1, 0);
+}
+
+/*
+ * Take up to len characters of input into buf, stopping after a
+ * newline (a typed '\r' reads as '\n'), and sleeping until at least
+ * one is there. Returns how many were taken.
+ */
+
+static
+size_t
+con_getinput(struct con_softc *cs, char *buf, size_t len)
+{
+	size_t n = 0;
+	int spl;
+
+	spl = splhigh();
+	while (cs->cs_ilen == 0) {
+		thread_sleep(&cs->cs_ilen);
+	}
+	while (n < len && cs->cs_ilen > 0) {
+		buf[n] = cs->cs_ibuf[cs->cs_ihead];
+		cs->cs_ihead = (cs->cs_ihead + 1) % CON_IBUFSIZE;
+		cs->cs_ilen--;
+		if (buf[n] == '\r') {
+			buf[n] = '\n';
+		}
+		if (buf[n++] == '\n') {
+			break;
+		}
+	}
+	splx(spl);
+	return n;
 }
 
 /*
@@ -114,8 +225,17 @@ static
 int
 getch_intr(struct con_softc *cs)
 {
-	P(cs->cs_rsem);
-	return cs->cs_gotchar;
+	int spl, ch;
+
+	spl = splhigh();
+	while (cs->cs_ilen == 0) {
+		thread_sleep(&cs->cs_ilen);
+	}
+	ch = cs->cs_ibuf[cs->cs_ihead];
+	cs->cs_ihead = (cs->cs_ihead + 1) % CON_IBUFSIZE;
+	cs->cs_ilen--;
+	splx(spl);
+	return ch;
 }
 
 /*
@@ -126,8 +246,14 @@ con_input(void *vcs, int ch)
 {
 	struct con_softc *cs = vcs;
 
-	cs->cs_gotchar = ch;
-	V(cs->cs_rsem);
+	if (cs->cs_ilen == CON_IBUFSIZE) {
+		/* nobody is reading; drop it */
+		return;
+	}
+	cs->cs_ibuf[(cs->cs_ihead + cs->cs_ilen) % CON_IBUFSIZE] = ch;
+	if (cs->cs_ilen++ == 0) {
+		thread_wakeup(&cs->cs_ilen);
+	}
 }
 
 /*
@@ -138,7 +264,8 @@ con_start(void *vcs)
 {
 	struct con_softc *cs = vcs;
 
-	V(cs->cs_wsem);
+	cs->cs_obusy = 0;
+	con_kick(cs);
 }
 
 //////////////////////////////////////////////////
@@ -200,15 +327,23 @@ con_close(struct device *dev)
 	return 0;
 }
 
+/*
+ * Staging buffer for con_io, one per direction, each used only with
+ * the matching user lock held. Writes are copied in here with one
+ * uiomove and then into the output ring; reads are gathered here
+ * from the input ring and copied out with one uiomove.
+ */
+static char con_wbuf[CON_OBUFSIZE/2];
+static char con_rbuf[CON_IBUFSIZE];
+
 static
 int
 con_io(struct device *dev, struct uio *uio)
 {
 	int result;
-	char ch;
+	size_t n;
 	struct lock *lk;
-
-	(void)dev;  // unused
+	struct con_softc *cs = dev->d_data;
 
 	if (uio->uio_rw==UIO_READ) {
 		lk = con_userlock_read;
@@ -222,29 +357,31 @@ con_io(struct device *dev, struct uio *uio)
 
 	while (uio->uio_resid > 0) {
 		if (uio->uio_rw==UIO_READ) {
-			ch = getch();
-			if (ch=='\r') {
-				ch = '\n';
+			n = uio->uio_resid;
+			if (n > sizeof(con_rbuf)) {
+				n = sizeof(con_rbuf);
 			}
-			result = uiomove(&ch, 1, uio);
+			n = con_getinput(cs, con_rbuf, n);
+			result = uiomove(con_rbuf, n, uio);
 			if (result) {
 				lock_release(lk);
 				return result;
 			}
-			if (ch=='\n') {
+			if (con_rbuf[n-1]=='\n') {
 				break;
 			}
 		}
 		else {
-			result = uiomove(&ch, 1, uio);
+			n = uio->uio_resid;
+			if (n > sizeof(con_wbuf)) {
+				n = sizeof(con_wbuf);
+			}
+			result = uiomove(con_wbuf, n, uio);
 			if (result) {
 				lock_release(lk);
 				return result;
 			}
-			if (ch=='\n') {
-				putch('\r');
-			}
-			putch(ch);
+			con_enqueue(cs, con_wbuf, n, 1);
 		}
 	}
 	lock_release(lk);
@@ -300,7 +437,6 @@ attach_console_to_vfs(struct con_softc *cs)
 int
 config_con(struct con_softc *cs, int unit)
 {
-	struct semaphore *rsem, *wsem;
 	struct lock *rlk, *wlk;
 
 	/*
@@ -316,32 +452,19 @@ config_con(struct con_softc *cs, int unit)
 	}
 	assert(the_console==NULL);
 
-	rsem = sem_create("console read", 0);
-	if (rsem == NULL) {
-		return ENOMEM;
-	}
-	wsem = sem_create("console write", 1);
-	if (wsem == NULL) {
-		sem_destroy(rsem);
-		return ENOMEM;
-	}
 	rlk = lock_create("console-lock-read");
 	if (rlk == NULL) {
-		sem_destroy(rsem);
-		sem_destroy(wsem);
 		return ENOMEM;
 	}
 	wlk = lock_create("console-lock-write");
 	if (wlk == NULL) {
 		lock_destroy(rlk);
-		sem_destroy(rsem);
-		sem_destroy(wsem);
 		return ENOMEM;
 	}
 
-	cs->cs_rsem = rsem; 
-	cs->cs_wsem = wsem; 
-	cs->cs_gotchar = 0;
+	cs->cs_ohead = cs->cs_olen = 0;
+	cs->cs_obusy = 0;
+	cs->cs_ihead = cs->cs_ilen = 0;
 
 	the_console = cs;
 	con_userlock_read = rlk;
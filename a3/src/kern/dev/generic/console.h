@@ -6,18 +6,26 @@
  *
  * devdata, send, and sendpolled are provided by the underlying
  * device, and are to be initialized by the attach routine.
+ *
+ * Output goes through the ring cs_obuf, which the device's write-done
+ * interrupt drains; input collects in cs_ibuf as it is typed.
  */
 
+#define CON_OBUFSIZE  1024
+#define CON_IBUFSIZE  256
+
 struct con_softc {
 	/* initialized by attach routine */
 	void *cs_devdata;
 	void (*cs_send)(void *devdata, int ch);
 	void (*cs_sendpolled)(void *devdata, int ch);
 
-	/* initialized by config routine */
-	struct semaphore *cs_rsem;
-	struct semaphore *cs_wsem;
-	int cs_gotchar;
+	/* initialized by config routine; synchronized with spl */
+	char cs_obuf[CON_OBUFSIZE];	/* output waiting for the device */
+	unsigned cs_ohead, cs_olen;
+	int cs_obusy;			/* device is sending a character */
+	char cs_ibuf[CON_IBUFSIZE];	/* input not yet read */
+	unsigned cs_ihead, cs_ilen;
 };
 
 /*
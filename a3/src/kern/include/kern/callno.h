@@ -40,6 +40,7 @@
 #define SYS___getcwd     29
 #define SYS_stat         30
 #define SYS_lstat        31
+#define SYS_sendfile     32
 
 // BEGIN A0 SOLUTION 
 #define SYS_helloworld  40
@@ -7,6 +7,9 @@
 /* Longest full path name */
 #define PATH_MAX   1024
 
+/* Largest int; system calls that return a byte count stop short of it */
+#define INT_MAX    0x7fffffff
+
 // BEGIN ASST1
 /* min value for a process ID (that can be assigned to a user process) */
 #define PID_MIN	2
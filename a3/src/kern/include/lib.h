@@ -109,6 +109,7 @@ char *strtok_r(char *buf, const char *seps, char **context);
 
 void *memcpy(void *, const void *, size_t);
 void *memmove(void *, const void *, size_t);
+void *memset(void *, int, size_t);
 void bzero(void *, size_t);
 int atoi(const char *);
 
@@ -34,7 +34,10 @@ int sys_getdirentry(int fd, userptr_t buf, size_t buflen, int *retval);
 int sys_fstat(int fd, userptr_t statptr);
 int sys_mkdir(userptr_t path, int mode);
 int sys_rmdir(userptr_t path);
+int sys_sendfile(int outfd, int infd, size_t count, int *retval);
 
 // END A3 SETUP
 
+int sys___time(userptr_t seconds, userptr_t nanoseconds, int *retval);
+
 #endif /* _SYSCALL_H_ */
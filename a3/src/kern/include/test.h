@@ -27,6 +27,7 @@ int locktest(int, char **);
 int cvtest(int, char **);
 int jointest1(int, char **); // ASST1 test for thread_join
 int jointest2(int, char **); // ASST1 test for thread_join
+int pingpongtest(int, char **);
 
 /* filesystem tests */
 int fstest(int, char **);
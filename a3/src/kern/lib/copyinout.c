@@ -46,6 +46,13 @@
 #include <thread.h>
 #include <curthread.h>
 
+/* Word size and mask for the word-at-a-time string scan. */
+#define WSIZE  sizeof(u_int32_t)
+#define WMASK  (WSIZE-1)
+
+/* Nonzero if some byte of the word W is 0. */
+#define HASZERO(w)  (((w) - 0x01010101) & ~(w) & 0x80808080)
+
 /*
  * Recovery function. If a fatal fault occurs during copyin, copyout,
  * copyinstr, or copyoutstr, execution resumes here. (This behavior is
@@ -195,21 +202,57 @@ int
 copystr(char *dest, const char *src, size_t maxlen, size_t stoplen,
 	size_t *gotlen)
 {
-	size_t i;
-	for (i=0; i<maxlen && i<stoplen; i++) {
+	size_t i, lim;
+	u_int32_t w;
+
+	lim = maxlen < stoplen ? maxlen : stoplen;
+	i = 0;
+
+	/*
+	 * Scan a word at a time once SRC is aligned. An aligned word
+	 * never crosses a page, nor USERTOP, so it cannot fault unless
+	 * the byte-at-a-time copy would have faulted on its first byte.
+	 * The word holding the terminator, and anything past LIM, is
+	 * left to the byte loop.
+	 */
+	while (i < lim && ((vaddr_t)(src+i) & WMASK) != 0) {
+		dest[i] = src[i];
+		if (src[i]==0) {
+			goto found;
+		}
+		i++;
+	}
+	while (i + WSIZE <= lim) {
+		w = *(const u_int32_t *)(src+i);
+		if (HASZERO(w)) {
+			break;
+		}
+		if (((vaddr_t)(dest+i) & WMASK) == 0) {
+			*(u_int32_t *)(dest+i) = w;
+		}
+		else {
+			memcpy(dest+i, &w, WSIZE);
+		}
+		i += WSIZE;
+	}
+	for (; i<lim; i++) {
 		dest[i] = src[i];
 		if (src[i]==0) {
-			if (gotlen != NULL) {
-				*gotlen = i+1;
-			}
-			return 0;
+			goto found;
 		}
 	}
+
 	if (stoplen < maxlen) {
 		/* ran into user-kernel boundary */
 		return EFAULT;
 	}
 	return ENAMETOOLONG;
+
+ found:
+	if (gotlen != NULL) {
+		*gotlen = i+1;
+	}
+	return 0;
 }
 
 /*
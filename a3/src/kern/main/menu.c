@@ -451,6 +451,7 @@ static const char *testmenu[] = {
 	"[tt3] Thread test 3                 ",
         "[join1] Join test 1                 ",
         "[join2] Join test 2                 ",
+	"[pp]  Thread switch ping-pong       ",
 #if OPT_NET
 	"[net] Network test                  ",
 #endif
@@ -569,6 +570,7 @@ static struct {
 
         { "join1",      jointest1 },
 	{ "join2",      jointest2 },
+	{ "pp",		pingpongtest },
 
 	{ "sy1",	semtest },
 
@@ -0,0 +1,84 @@
+/*
+ * Thread switch ping-pong benchmark.
+ *
+ * Two kernel threads hand control back and forth through a pair of
+ * semaphores, so every round trip is two context switches. Compare
+ * with /testbin/pingpong, which does the same with user-level threads.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <synch.h>
+#include <thread.h>
+#include <test.h>
+#include <clock.h>
+#include <kern/errno.h>
+
+#define PP_ROUNDS  10000
+
+static struct semaphore *ping, *pong, *ppdone;
+
+static
+void
+pongthread(void *junk, unsigned long rounds)
+{
+	unsigned long i;
+
+	(void)junk;
+
+	for (i=0; i<rounds; i++) {
+		P(ping);
+		V(pong);
+	}
+	V(ppdone);
+}
+
+int
+pingpongtest(int nargs, char **args)
+{
+	unsigned long rounds = PP_ROUNDS, i, switches, usecs;
+	time_t secs1, secs2, secs;
+	u_int32_t nsecs1, nsecs2, nsecs;
+	int result;
+
+	if (nargs > 1) {
+		rounds = atoi(args[1]);
+	}
+	if (rounds == 0) {
+		kprintf("Usage: pp [rounds]\n");
+		return EINVAL;
+	}
+
+	ping = sem_create("ping", 0);
+	pong = sem_create("pong", 0);
+	ppdone = sem_create("ppdone", 0);
+	if (ping == NULL || pong == NULL || ppdone == NULL) {
+		panic("pingpong: sem_create failed\n");
+	}
+
+	result = thread_fork("pingpong", NULL, rounds, pongthread, NULL);
+	if (result) {
+		panic("pingpong: thread_fork failed %s\n", strerror(result));
+	}
+
+	gettime(&secs1, &nsecs1);
+	for (i=0; i<rounds; i++) {
+		V(ping);
+		P(pong);
+	}
+	gettime(&secs2, &nsecs2);
+	P(ppdone);
+
+	getinterval(secs1, nsecs1, secs2, nsecs2, &secs, &nsecs);
+	usecs = secs * 1000000 + nsecs / 1000;
+	switches = 2 * rounds;
+	kprintf("kernel threads: %lu switches in %lu.%06lu s, "
+		"%lu ns per switch\n", switches, usecs / 1000000,
+		usecs % 1000000,
+		(usecs / switches) * 1000 + (usecs % switches) * 1000 / switches);
+
+	sem_destroy(ping);
+	sem_destroy(pong);
+	sem_destroy(ppdone);
+	return 0;
+}
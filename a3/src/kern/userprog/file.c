@@ -62,7 +62,7 @@ file_open(char *filename, int flags, int mode, int *retfd)
   }
 
   /* Initialize the file structure */
-  of->of_accmode = flags;
+  of->of_accmode = flags & O_ACCMODE;
   of->of_offset = 0;
   of->of_refcount = 1;
 
@@ -12,6 +12,7 @@
 #include <uio.h>
 #include <thread.h>
 #include <curthread.h>
+#include <vm.h>
 #include <vfs.h>
 #include <vnode.h>
 #include <syscall.h>
@@ -128,7 +129,8 @@ sys_open(userptr_t filename, int flags, int mode, int *retval)
  *
  * Note that any problems with the address supplied by the
  * user as "buf" will be handled by the VOP_READ / uio code
- * so you do not have to try to verify "buf" yourself.
+ * (copyout fails with EFAULT) so you do not have to try to
+ * verify "buf" yourself.
  *
  * Most of this code should be replaced.
  */
@@ -184,8 +186,9 @@ sys_read(int fd, userptr_t buf, size_t size, int *retval)
  * then read from the vnode recorded in that openfile.
  *
  * Note that any problems with the address supplied by the
- * user as "buf" will be handled by the VOP_READ / uio code
- * so you do not have to try to verify "buf" yourself.
+ * user as "buf" will be handled by the VOP_WRITE / uio code
+ * (copyin fails with EFAULT) so you do not have to try to
+ * verify "buf" yourself.
  *
  * Most of this code should be replaced.
  */
@@ -512,3 +515,82 @@ sys_fstat(int fd, userptr_t statptr)
 
   return 0;
 }
+
+/*
+ * sys_sendfile
+ * copies up to count bytes from infd to outfd without passing them
+ * through user space. The data goes through one kernel page at a
+ * time, so a copy costs one system call rather than a read and a
+ * write per user buffer, and no copyin or copyout at all.
+ */
+int
+sys_sendfile(int outfd, int infd, size_t count, int *retval)
+{
+  int result;
+  struct openfile *in, *out;
+  struct uio ku;
+  char *buf;
+  size_t done, amt, got;
+
+  result = filetable_findfile(infd, &in);
+  if(result){
+    return result;
+  }
+  result = filetable_findfile(outfd, &out);
+  if(result){
+    return result;
+  }
+  if (in->of_accmode == O_WRONLY || out->of_accmode == O_RDONLY) {
+    return EBADF;
+  }
+
+  /* the count comes back through an int, so copy at most INT_MAX */
+  if (count > INT_MAX) {
+    count = INT_MAX;
+  }
+
+  buf = kmalloc(PAGE_SIZE);
+  if (buf == NULL) {
+    return ENOMEM;
+  }
+
+  done = 0;
+  while (done < count) {
+    amt = count - done;
+    if (amt > PAGE_SIZE) {
+      amt = PAGE_SIZE;
+    }
+
+    mk_kuio(&ku, buf, amt, in->of_offset, UIO_READ);
+    result = VOP_READ(in->of_vnode, &ku);
+    if (result) {
+      break;
+    }
+    got = amt - ku.uio_resid;
+    if (got == 0) {
+      /* end of file */
+      break;
+    }
+    in->of_offset = ku.uio_offset;
+
+    mk_kuio(&ku, buf, got, out->of_offset, UIO_WRITE);
+    result = VOP_WRITE(out->of_vnode, &ku);
+    out->of_offset = ku.uio_offset;
+    done += got - ku.uio_resid;
+
+    /* leave the input offset just past what was written */
+    in->of_offset -= ku.uio_resid;
+    if (result || ku.uio_resid > 0) {
+      break;
+    }
+  }
+
+  kfree(buf);
+
+  /* like write, report an error only if nothing was copied */
+  if (result && done == 0) {
+    return result;
+  }
+  *retval = done;
+  return 0;
+}
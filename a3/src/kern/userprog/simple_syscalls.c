@@ -6,6 +6,7 @@
 #include <kern/limits.h>
 #include <kern/errno.h>
 #include <thread.h>
+#include <clock.h>
 
 
 // Simplest possible system call.  Technically, it should just return 
@@ -51,3 +52,30 @@ int sys__exit(int exitcode) {
 }
 
 // END A0 SOLUTION
+
+// Current time of day, for time() and for timing things at user level.
+// Either pointer may be NULL.
+
+int sys___time(userptr_t seconds, userptr_t nanoseconds, int *retval) {
+	time_t secs;
+	u_int32_t nsecs;
+	int result;
+
+	gettime(&secs, &nsecs);
+
+	if (seconds != NULL) {
+		result = copyout(&secs, seconds, sizeof(secs));
+		if (result) {
+			return result;
+		}
+	}
+	if (nanoseconds != NULL) {
+		result = copyout(&nsecs, nanoseconds, sizeof(nsecs));
+		if (result) {
+			return result;
+		}
+	}
+
+	*retval = secs;
+	return 0;
+}
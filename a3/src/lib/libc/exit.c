@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <unistd.h>
 
 /*
@@ -11,8 +12,10 @@ exit(int code)
 	/*
 	 * In a more complicated libc, this would call functions registered
 	 * with atexit() before calling the syscall to actually exit.
+	 * We only have the stdio buffers to write out.
 	 */
 
+	fflush(NULL);
 	_exit(code);
 }
 
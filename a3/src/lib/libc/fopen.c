@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <errno.h>
+
+/*
+ * Opening and closing buffered streams. With no malloc, streams and
+ * their buffers come from a static pool; a slot is free while its
+ * f_flags is 0.
+ */
+
+static FILE __fopen_files[FOPEN_MAX];
+static char __fopen_bufs[FOPEN_MAX][BUFSIZ];
+
+/*
+ * Turn an fopen mode string into open flags, and stream flags in
+ * *sflags. Returns -1 for a bad mode.
+ */
+static
+int
+__sflags(const char *mode, int *sflags)
+{
+	int oflags;
+
+	switch (mode[0]) {
+	    case 'r':
+		oflags = O_RDONLY;
+		*sflags = __SRD;
+		break;
+	    case 'w':
+		oflags = O_WRONLY | O_CREAT | O_TRUNC;
+		*sflags = __SWR;
+		break;
+	    case 'a':
+		oflags = O_WRONLY | O_CREAT | O_APPEND;
+		*sflags = __SWR;
+		break;
+	    default:
+		return -1;
+	}
+
+	/* "b" means nothing here; "+" means read and write */
+	for (mode++; *mode; mode++) {
+		if (*mode == '+') {
+			oflags = (oflags & ~O_ACCMODE) | O_RDWR;
+			*sflags = __SRD | __SWR;
+		}
+	}
+	return oflags;
+}
+
+FILE *
+fdopen(int fd, const char *mode)
+{
+	FILE *f;
+	int sflags, i;
+
+	if (__sflags(mode, &sflags) < 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	for (i=0; i<FOPEN_MAX; i++) {
+		if (__fopen_files[i].f_flags == 0) {
+			break;
+		}
+	}
+	if (i == FOPEN_MAX) {
+		errno = EMFILE;
+		return NULL;
+	}
+
+	f = &__fopen_files[i];
+	f->f_fd = fd;
+	f->f_flags = sflags;
+	f->f_mode = _IOFBF;
+	f->f_buf = __fopen_bufs[i];
+	f->f_size = BUFSIZ;
+	f->f_pos = f->f_len = 0;
+	f->f_next = __stdio_list;
+	__stdio_list = f;
+	return f;
+}
+
+FILE *
+fopen(const char *path, const char *mode)
+{
+	FILE *f;
+	int oflags, sflags, fd;
+
+	oflags = __sflags(mode, &sflags);
+	if (oflags < 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	fd = open(path, oflags, 0664);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	f = fdopen(fd, mode);
+	if (f == NULL) {
+		close(fd);
+	}
+	return f;
+}
+
+int
+fclose(FILE *f)
+{
+	FILE **p;
+	int result;
+
+	result = fflush(f);
+	if (close(f->f_fd)) {
+		result = EOF;
+	}
+
+	for (p = &__stdio_list; *p != NULL; p = &(*p)->f_next) {
+		if (*p == f) {
+			*p = f->f_next;
+			break;
+		}
+	}
+	f->f_flags = 0;
+	return result;
+}
@@ -0,0 +1,23 @@
+#include <stdio.h>
+#include <unistd.h>
+
+/*
+ * fork and execv: the system calls __fork and __execv, after writing
+ * out the stdio buffers. Otherwise output still buffered at a fork
+ * would be copied into the child and written by both processes, and
+ * output buffered at an execv would be lost with the old image.
+ */
+
+pid_t
+fork(void)
+{
+	fflush(NULL);
+	return __fork();
+}
+
+int
+execv(const char *prog, char *const *args)
+{
+	fflush(NULL);
+	return __execv(prog, args);
+}
@@ -10,6 +10,21 @@
 #include <string.h>
 #endif
 
+/*
+ * Word size, and the mask for the offset of a byte within a word.
+ */
+#define WSIZE  sizeof(unsigned long)
+#define WMASK  (WSIZE - 1)
+
+/* See memcpy.c. */
+#ifdef _BIG_ENDIAN
+#define MERGE(lo, hi, shift) \
+	(((lo) << (shift)) | ((hi) >> (WSIZE * 8 - (shift))))
+#else
+#define MERGE(lo, hi, shift) \
+	(((lo) >> (shift)) | ((hi) << (WSIZE * 8 - (shift))))
+#endif
+
 /*
  * C standard function - copy a block of memory, handling overlapping
  * regions correctly.
@@ -18,7 +33,8 @@
 void *
 memmove(void *dst, const void *src, size_t len)
 {
-	size_t i;
+	unsigned char *d;
+	const unsigned char *s;
 
 	/*
 	 * If the buffers don't overlap, it doesn't matter what direction
@@ -54,34 +70,74 @@ memmove(void *dst, const void *src, size_t len)
 	}
 
 	/*
-	 * Copy by words in the common case. Look in memcpy.c for more
+	 * Copy back to front the way memcpy copies front to back: a
+	 * byte tail down to a word boundary in dst, a body of words,
+	 * and the bytes left at the front. Look in memcpy.c for more
 	 * information.
 	 */
 
-	if ((uintptr_t)dst % sizeof(long) == 0 &&
-	    (uintptr_t)src % sizeof(long) == 0 &&
-	    len % sizeof(long) == 0) {
+	d = (unsigned char *)dst + len;
+	s = (const unsigned char *)src + len;
 
-		long *d = dst;
-		const long *s = src;
+	if (len >= 4 * WSIZE) {
+		while ((uintptr_t)d & WMASK) {
+			*--d = *--s;
+			len--;
+		}
 
-		/*
-		 * The reason we copy index i-1 and test i>0 is that
-		 * i is unsigned - so testing i>=0 doesn't work.
-		 */
+		if (((uintptr_t)s & WMASK) == 0) {
+			unsigned long *wd = (unsigned long *)d;
+			const unsigned long *ws = (const unsigned long *)s;
 
-		for (i=len/sizeof(long); i>0; i--) {
-			d[i-1] = s[i-1];
+			while (len >= 8 * WSIZE) {
+				wd -= 8;
+				ws -= 8;
+				wd[7] = ws[7];
+				wd[6] = ws[6];
+				wd[5] = ws[5];
+				wd[4] = ws[4];
+				wd[3] = ws[3];
+				wd[2] = ws[2];
+				wd[1] = ws[1];
+				wd[0] = ws[0];
+				len -= 8 * WSIZE;
+			}
+			while (len >= WSIZE) {
+				*--wd = *--ws;
+				len -= WSIZE;
+			}
+			d = (unsigned char *)wd;
+			s = (const unsigned char *)ws;
 		}
-	}
-	else {
-		char *d = dst;
-		const char *s = src;
+		else {
+			/*
+			 * hi starts as the aligned word holding the last
+			 * bytes of src; each step loads the word below it.
+			 */
+			unsigned shift = ((uintptr_t)s & WMASK) * 8;
+			unsigned long *wd = (unsigned long *)d;
+			const unsigned long *ws =
+				(const unsigned long *)((uintptr_t)s & ~WMASK);
+			unsigned long hi = *ws, lo;
+			size_t words = len / WSIZE;
 
-		for (i=len; i>0; i--) {
-			d[i-1] = s[i-1];
+			len -= words * WSIZE;
+			s -= words * WSIZE;
+
+			while (words > 0) {
+				lo = *--ws;
+				*--wd = MERGE(lo, hi, shift);
+				hi = lo;
+				words--;
+			}
+			d = (unsigned char *)wd;
 		}
 	}
 
+	while (len > 0) {
+		*--d = *--s;
+		len--;
+	}
+
 	return dst;
 }
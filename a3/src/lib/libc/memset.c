@@ -1,4 +1,20 @@
+/*
+ * This file is shared between libc and the kernel, so don't put anything
+ * in here that won't work in both contexts.
+ */
+
+#ifdef _KERNEL
+#include <types.h>
+#include <lib.h>
+#else
 #include <string.h>
+#endif
+
+/*
+ * Word size, and the mask for the offset of a byte within a word.
+ */
+#define WSIZE  sizeof(unsigned long)
+#define WMASK  (WSIZE - 1)
 
 /*
  * C standard function - initialize a block of memory
@@ -7,11 +23,50 @@
 void *
 memset(void *ptr, int ch, size_t len)
 {
-	char *p = ptr;
-	size_t i;
-	
-	for (i=0; i<len; i++) {
-		p[i] = ch;
+	unsigned char *p = ptr;
+
+	/*
+	 * As in memcpy: bytes up to a word boundary, then whole words
+	 * of ch repeated, eight at a time, then the bytes left over.
+	 */
+
+	if (len >= 4 * WSIZE) {
+		unsigned long *wp, w;
+		unsigned i;
+
+		while ((uintptr_t)p & WMASK) {
+			*p++ = ch;
+			len--;
+		}
+
+		w = (unsigned char)ch;
+		for (i=8; i<WSIZE*8; i*=2) {
+			w |= w << i;
+		}
+
+		wp = (unsigned long *)p;
+		while (len >= 8 * WSIZE) {
+			wp[0] = w;
+			wp[1] = w;
+			wp[2] = w;
+			wp[3] = w;
+			wp[4] = w;
+			wp[5] = w;
+			wp[6] = w;
+			wp[7] = w;
+			wp += 8;
+			len -= 8 * WSIZE;
+		}
+		while (len >= WSIZE) {
+			*wp++ = w;
+			len -= WSIZE;
+		}
+		p = (unsigned char *)wp;
+	}
+
+	while (len > 0) {
+		*p++ = ch;
+		len--;
 	}
 
 	return ptr;
@@ -1,21 +1,13 @@
 #include <stdio.h>
-#include <unistd.h>
 
 /*
  * C standard function - print a single character.
  *
- * Properly, stdio is supposed to be buffered, but for present purposes
- * writing that code is not really worthwhile.
+ * This goes into the stdout buffer; see stdio.c.
  */
 
 int
 putchar(int ch)
 {
-	char c = ch;
-	int len;
-	len = write(STDOUT_FILENO, &c, 1);
-	if (len<=0) {
-		return EOF;
-	}
-	return ch;
+	return fputc(ch, stdout);
 }
@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+/*
+ * Buffered stream core: the three standard streams, buffered reading
+ * and writing, and fflush. fopen and fclose are in fopen.c so that
+ * programs that only print don't carry its stream pool.
+ *
+ * A stream's buffer holds either output not yet written (f_pos bytes)
+ * or input read ahead (f_pos..f_len, with __SRDING set), never both.
+ */
+
+static char __stdout_buf[BUFSIZ];
+
+static FILE __stderr = {
+	STDERR_FILENO, __SWR, _IONBF, &__stderr.f_ch, 1, 0, 0, 0, NULL
+};
+static FILE __stdout = {
+	STDOUT_FILENO, __SWR | __SPROBE, _IOLBF, __stdout_buf, BUFSIZ,
+	0, 0, 0, &__stderr
+};
+static FILE __stdin = {
+	STDIN_FILENO, __SRD, _IONBF, &__stdin.f_ch, 1, 0, 0, 0, &__stdout
+};
+
+FILE *stdin = &__stdin;
+FILE *stdout = &__stdout;
+FILE *stderr = &__stderr;
+
+FILE *__stdio_list = &__stdin;
+
+/*
+ * Write all of len bytes to f's file, however many write calls
+ * that takes.
+ */
+static
+int
+__swriteall(FILE *f, const char *data, size_t len)
+{
+	int r;
+
+	while (len > 0) {
+		r = write(f->f_fd, data, len);
+		if (r <= 0) {
+			f->f_flags |= __SERR;
+			return EOF;
+		}
+		data += r;
+		len -= r;
+	}
+	return 0;
+}
+
+/*
+ * Drop read-ahead before writing, moving the file offset back to
+ * where the reader thinks it is.
+ */
+static
+void
+__sdropread(FILE *f)
+{
+	if (f->f_flags & __SRDING) {
+		if (f->f_len > f->f_pos) {
+			lseek(f->f_fd, -(off_t)(f->f_len - f->f_pos), SEEK_CUR);
+		}
+		f->f_pos = f->f_len = 0;
+		f->f_flags &= ~__SRDING;
+	}
+}
+
+int
+fflush(FILE *f)
+{
+	int result = 0;
+
+	if (f == NULL) {
+		for (f = __stdio_list; f != NULL; f = f->f_next) {
+			if (fflush(f)) {
+				result = EOF;
+			}
+		}
+		return result;
+	}
+
+	if (f->f_flags & __SRDING) {
+		__sdropread(f);
+		return 0;
+	}
+	if (f->f_pos > 0) {
+		result = __swriteall(f, f->f_buf, f->f_pos);
+		f->f_pos = 0;
+	}
+	return result;
+}
+
+/*
+ * Append len bytes to f's buffer, writing it out as it fills, and
+ * after a newline if f is line buffered. Data at least a buffer long
+ * that arrives with the buffer empty is written straight through,
+ * which is also how unbuffered streams, with their one-byte buffer,
+ * write everything.
+ */
+static
+int
+__sputn(FILE *f, const char *data, size_t len)
+{
+	size_t n, i;
+	int newline = 0;
+
+	if (!(f->f_flags & __SWR)) {
+		f->f_flags |= __SERR;
+		errno = EBADF;
+		return EOF;
+	}
+	__sdropread(f);
+
+	if (f->f_flags & __SPROBE) {
+		struct stat st;
+
+		f->f_flags &= ~__SPROBE;
+		if (fstat(f->f_fd, &st) == 0 && S_ISREG(st.st_mode)) {
+			f->f_mode = _IOFBF;
+		}
+	}
+
+	if (f->f_mode == _IOLBF) {
+		for (i=0; i<len; i++) {
+			if (data[i] == '\n') {
+				newline = 1;
+				break;
+			}
+		}
+	}
+
+	while (len > 0) {
+		if (f->f_pos == 0 && len >= f->f_size) {
+			return __swriteall(f, data, len);
+		}
+
+		n = f->f_size - f->f_pos;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(f->f_buf + f->f_pos, data, n);
+		f->f_pos += n;
+		data += n;
+		len -= n;
+
+		if (f->f_pos == f->f_size && fflush(f)) {
+			return EOF;
+		}
+	}
+
+	if (newline) {
+		return fflush(f);
+	}
+	return 0;
+}
+
+/*
+ * Refill f's buffer. Output to stdout is flushed first, so that a
+ * prompt is seen before the program waits for the answer.
+ */
+static
+int
+__srefill(FILE *f)
+{
+	int r;
+
+	if (!(f->f_flags & __SRD)) {
+		f->f_flags |= __SERR;
+		errno = EBADF;
+		return EOF;
+	}
+	if (fflush(f)) {
+		return EOF;
+	}
+	if (f != stdout) {
+		fflush(stdout);
+	}
+
+	r = read(f->f_fd, f->f_buf, f->f_size);
+	if (r <= 0) {
+		f->f_flags |= (r == 0) ? __SEOF : __SERR;
+		return EOF;
+	}
+	f->f_pos = 0;
+	f->f_len = r;
+	f->f_flags |= __SRDING;
+	return 0;
+}
+
+size_t
+fwrite(const void *ptr, size_t size, size_t nmemb, FILE *f)
+{
+	if (size == 0 || nmemb == 0) {
+		return 0;
+	}
+	if (__sputn(f, ptr, size * nmemb)) {
+		return 0;
+	}
+	return nmemb;
+}
+
+int
+fputc(int ch, FILE *f)
+{
+	char c = ch;
+
+	if (__sputn(f, &c, 1)) {
+		return EOF;
+	}
+	return (int)(unsigned char)c;
+}
+
+int
+fputs(const char *s, FILE *f)
+{
+	return __sputn(f, s, strlen(s));
+}
+
+size_t
+fread(void *ptr, size_t size, size_t nmemb, FILE *f)
+{
+	char *dest = ptr;
+	size_t want = size * nmemb, got = 0, n;
+
+	if (want == 0) {
+		return 0;
+	}
+
+	while (got < want) {
+		if (!(f->f_flags & __SRDING) || f->f_pos == f->f_len) {
+			if (__srefill(f)) {
+				break;
+			}
+		}
+		n = f->f_len - f->f_pos;
+		if (n > want - got) {
+			n = want - got;
+		}
+		memcpy(dest + got, f->f_buf + f->f_pos, n);
+		f->f_pos += n;
+		got += n;
+	}
+	return got / size;
+}
+
+int
+fgetc(FILE *f)
+{
+	if (!(f->f_flags & __SRDING) || f->f_pos == f->f_len) {
+		if (__srefill(f)) {
+			return EOF;
+		}
+	}
+	return (int)(unsigned char)f->f_buf[f->f_pos++];
+}
+
+/*
+ * Use buf (or, if buf is NULL, the stream's own buffer) in the given
+ * mode. Only allowed before any I/O on the stream.
+ */
+int
+setvbuf(FILE *f, char *buf, int mode, size_t size)
+{
+	if (f->f_pos != 0 || (f->f_flags & __SRDING)) {
+		return EOF;
+	}
+
+	switch (mode) {
+	    case _IONBF:
+		f->f_buf = &f->f_ch;
+		f->f_size = 1;
+		break;
+	    case _IOLBF:
+	    case _IOFBF:
+		if (buf != NULL && size > 0) {
+			f->f_buf = buf;
+			f->f_size = size;
+		}
+		else if (f->f_buf == &f->f_ch) {
+			/* no malloc to get one with */
+			return EOF;
+		}
+		break;
+	    default:
+		return EOF;
+	}
+	f->f_mode = mode;
+	f->f_flags &= ~__SPROBE;
+	return 0;
+}
+
+int
+fileno(FILE *f)
+{
+	return f->f_fd;
+}
+
+int
+feof(FILE *f)
+{
+	return (f->f_flags & __SEOF) != 0;
+}
+
+int
+ferror(FILE *f)
+{
+	return (f->f_flags & __SERR) != 0;
+}
+
+void
+clearerr(FILE *f)
+{
+	f->f_flags &= ~(__SEOF | __SERR);
+}
+
+/*
+ * Function passed to __vprintf to do the actual output.
+ */
+static
+void
+__fprintf_send(void *mydata, const char *data, size_t len)
+{
+	__sputn(mydata, data, len);
+}
+
+int
+vfprintf(FILE *f, const char *fmt, va_list ap)
+{
+	int chars, err = f->f_flags & __SERR;
+
+	chars = __vprintf(__fprintf_send, f, fmt, ap);
+	if (!err && (f->f_flags & __SERR)) {
+		return EOF;
+	}
+	return chars;
+}
+
+int
+fprintf(FILE *f, const char *fmt, ...)
+{
+	int chars;
+	va_list ap;
+	va_start(ap, fmt);
+	chars = vfprintf(f, fmt, ap);
+	va_end(ap);
+	return chars;
+}
@@ -0,0 +1,364 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <setjmp.h>
+#include <assert.h>
+#include <errno.h>
+#include <err.h>
+#include <uthread.h>
+
+/*
+ * M:1 user-level threads; see uthread.h.
+ *
+ * A thread's context is a jmp_buf. Switching saves the current
+ * thread's registers with setjmp and resumes the next one with
+ * longjmp. A new thread gets a context made by hand, with sp at the
+ * top of its stack and ra pointing at uthread_start, so the first
+ * longjmp to it "returns" into uthread_start on the new stack.
+ */
+
+#define UT_FREE     0	/* slot unused */
+#define UT_READY    1	/* on the run queue */
+#define UT_RUNNING  2	/* the current thread */
+#define UT_BLOCKED  3	/* on a mutex, cv or join queue */
+#define UT_ZOMBIE   4	/* exited, waiting to be joined */
+
+/*
+ * Space the MIPS calling convention lets a function use above its
+ * caller's sp, for spilling its argument registers.
+ */
+#define UT_ARGSAVE  16
+
+struct uthread {
+	jmp_buf ut_ctx;
+	int ut_state;
+	void (*ut_func)(void *);
+	void *ut_arg;
+	int ut_detached;			/* free the slot at exit */
+	struct uthread *ut_next;		/* link on a queue */
+	struct uthread_queue ut_joiners;	/* threads in uthread_join */
+};
+
+static struct uthread ut_table[UTHREAD_MAX];
+
+/*
+ * Thread 0 is main and uses the process stack. The MIPS calling
+ * convention wants sp 8-byte aligned, which a char array alone does
+ * not promise.
+ */
+static char ut_stacks[UTHREAD_MAX-1][UTHREAD_STACKSIZE]
+	__attribute__((__aligned__(8)));
+
+static struct uthread *ut_cur;		/* NULL until first use */
+static struct uthread_queue ut_runq;
+static int ut_nlive;			/* threads that have not exited */
+
+static
+void
+ut_init(void)
+{
+	if (ut_cur == NULL) {
+		ut_cur = &ut_table[0];
+		ut_cur->ut_state = UT_RUNNING;
+		ut_nlive = 1;
+	}
+}
+
+static
+void
+ut_enqueue(struct uthread_queue *q, struct uthread *t)
+{
+	t->ut_next = NULL;
+	if (q->uq_tail == NULL) {
+		q->uq_head = t;
+	}
+	else {
+		q->uq_tail->ut_next = t;
+	}
+	q->uq_tail = t;
+}
+
+static
+struct uthread *
+ut_dequeue(struct uthread_queue *q)
+{
+	struct uthread *t = q->uq_head;
+
+	if (t != NULL) {
+		q->uq_head = t->ut_next;
+		if (q->uq_head == NULL) {
+			q->uq_tail = NULL;
+		}
+	}
+	return t;
+}
+
+static
+void
+ut_wake(struct uthread *t)
+{
+	t->ut_state = UT_READY;
+	ut_enqueue(&ut_runq, t);
+}
+
+/*
+ * Run the next ready thread. The caller has already put itself on
+ * whatever queue it belongs on (or none, if it has exited), and
+ * carries on from here once someone switches back to it.
+ */
+static
+void
+ut_switch(void)
+{
+	struct uthread *self = ut_cur;
+	struct uthread *next = ut_dequeue(&ut_runq);
+
+	if (next == NULL) {
+		if (ut_nlive == 0) {
+			exit(0);
+		}
+		errx(1, "uthread: deadlock: all threads are blocked");
+	}
+
+	if (setjmp(self->ut_ctx) == 0) {
+		ut_cur = next;
+		next->ut_state = UT_RUNNING;
+		longjmp(next->ut_ctx, 1);
+	}
+}
+
+/* Put the current thread on q and run something else. */
+static
+void
+ut_block(struct uthread_queue *q)
+{
+	ut_cur->ut_state = UT_BLOCKED;
+	ut_enqueue(q, ut_cur);
+	ut_switch();
+}
+
+/* Where every thread but main starts. */
+static
+void
+uthread_start(void)
+{
+	ut_cur->ut_func(ut_cur->ut_arg);
+	uthread_exit();
+}
+
+int
+uthread_create(void (*func)(void *), void *arg)
+{
+	struct uthread *t;
+	int i;
+
+	ut_init();
+
+	for (i=1; i<UTHREAD_MAX; i++) {
+		if (ut_table[i].ut_state == UT_FREE) {
+			break;
+		}
+	}
+	if (i == UTHREAD_MAX) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	t = &ut_table[i];
+	t->ut_func = func;
+	t->ut_arg = arg;
+	t->ut_detached = 0;
+	t->ut_joiners.uq_head = t->ut_joiners.uq_tail = NULL;
+
+	/* Start from our own registers, then move to the new stack. */
+	setjmp(t->ut_ctx);
+	t->ut_ctx[__JB_SP] =
+		(u_int32_t)(ut_stacks[i-1] + UTHREAD_STACKSIZE - UT_ARGSAVE);
+	t->ut_ctx[__JB_RA] = (u_int32_t)uthread_start;
+
+	ut_nlive++;
+	ut_wake(t);
+	return i;
+}
+
+int
+uthread_self(void)
+{
+	ut_init();
+	return ut_cur - ut_table;
+}
+
+void
+uthread_yield(void)
+{
+	ut_init();
+	if (ut_runq.uq_head == NULL) {
+		return;
+	}
+	ut_wake(ut_cur);
+	ut_switch();
+}
+
+void
+uthread_exit(void)
+{
+	struct uthread *t;
+
+	ut_init();
+	ut_nlive--;
+
+	/*
+	 * A detached thread gives up its slot now, although we are
+	 * still on its stack: nothing can take the slot before
+	 * ut_switch has left it, as no other thread runs until then.
+	 */
+	if (ut_cur->ut_detached) {
+		ut_cur->ut_state = UT_FREE;
+		ut_switch();
+		abort();
+	}
+
+	ut_cur->ut_state = UT_ZOMBIE;
+	while ((t = ut_dequeue(&ut_cur->ut_joiners)) != NULL) {
+		ut_wake(t);
+	}
+	ut_switch();
+
+	/* Nothing switches back to a zombie. */
+	abort();
+}
+
+int
+uthread_join(int tid)
+{
+	struct uthread *t;
+
+	ut_init();
+
+	if (tid < 0 || tid >= UTHREAD_MAX || ut_table[tid].ut_state == UT_FREE) {
+		errno = ESRCH;
+		return -1;
+	}
+	t = &ut_table[tid];
+	if (t == ut_cur || t->ut_detached) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (t->ut_state != UT_ZOMBIE) {
+		ut_block(&t->ut_joiners);
+	}
+
+	/* A second joiner may have got here first. */
+	if (t->ut_state != UT_ZOMBIE) {
+		errno = ESRCH;
+		return -1;
+	}
+	t->ut_state = UT_FREE;
+	return 0;
+}
+
+int
+uthread_detach(int tid)
+{
+	struct uthread *t;
+
+	ut_init();
+
+	if (tid < 0 || tid >= UTHREAD_MAX || ut_table[tid].ut_state == UT_FREE) {
+		errno = ESRCH;
+		return -1;
+	}
+	t = &ut_table[tid];
+	if (tid == 0 || t->ut_detached || t->ut_joiners.uq_head != NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (t->ut_state == UT_ZOMBIE) {
+		t->ut_state = UT_FREE;
+	}
+	else {
+		t->ut_detached = 1;
+	}
+	return 0;
+}
+
+void
+uthread_mutex_init(struct uthread_mutex *m)
+{
+	m->um_owner = NULL;
+	m->um_waiters.uq_head = m->um_waiters.uq_tail = NULL;
+}
+
+void
+uthread_mutex_lock(struct uthread_mutex *m)
+{
+	ut_init();
+	if (m->um_owner == NULL) {
+		m->um_owner = ut_cur;
+		return;
+	}
+
+	assert(m->um_owner != ut_cur);
+	ut_block(&m->um_waiters);
+
+	/* uthread_mutex_unlock handed it to us */
+	assert(m->um_owner == ut_cur);
+}
+
+void
+uthread_mutex_unlock(struct uthread_mutex *m)
+{
+	struct uthread *t;
+
+	assert(m->um_owner == ut_cur);
+
+	t = ut_dequeue(&m->um_waiters);
+	m->um_owner = t;
+	if (t != NULL) {
+		ut_wake(t);
+	}
+}
+
+void
+uthread_cond_init(struct uthread_cond *c)
+{
+	c->uc_waiters.uq_head = c->uc_waiters.uq_tail = NULL;
+}
+
+void
+uthread_cond_wait(struct uthread_cond *c, struct uthread_mutex *m)
+{
+	ut_init();
+
+	/*
+	 * Nothing else runs until we switch, so queueing ourselves and
+	 * releasing the mutex cannot miss a signal.
+	 */
+	ut_cur->ut_state = UT_BLOCKED;
+	ut_enqueue(&c->uc_waiters, ut_cur);
+	uthread_mutex_unlock(m);
+	ut_switch();
+
+	uthread_mutex_lock(m);
+}
+
+void
+uthread_cond_signal(struct uthread_cond *c)
+{
+	struct uthread *t = ut_dequeue(&c->uc_waiters);
+
+	if (t != NULL) {
+		ut_wake(t);
+	}
+}
+
+void
+uthread_cond_broadcast(struct uthread_cond *c)
+{
+	struct uthread *t;
+
+	while ((t = ut_dequeue(&c->uc_waiters)) != NULL) {
+		ut_wake(t);
+	}
+}
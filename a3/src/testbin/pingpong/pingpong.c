@@ -0,0 +1,114 @@
+/*
+ * pingpong - time context switches between user-level threads.
+ * Usage: pingpong [rounds]
+ *
+ * Two threads hand control back and forth, first with plain
+ * uthread_yield and then through a mutex and condition variable, and
+ * we print the time per switch. Neither loop makes a system call.
+ * The kernel menu command "pp" does the same with kernel threads and
+ * semaphores, for comparison.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <err.h>
+#include <uthread.h>
+
+#define ROUNDS  100000
+
+static int rounds;
+
+/* whose turn it is in the mutex/cv test: 0 or 1 */
+static int turn;
+static struct uthread_mutex turnlock = UTHREAD_MUTEX_INITIALIZER;
+static struct uthread_cond turncv = UTHREAD_COND_INITIALIZER;
+
+static
+void
+yielder(void *junk)
+{
+	int i;
+
+	(void)junk;
+
+	for (i=0; i<rounds; i++) {
+		uthread_yield();
+	}
+}
+
+static
+void
+player(void *me)
+{
+	int i, self = (int)me;
+
+	for (i=0; i<rounds; i++) {
+		uthread_mutex_lock(&turnlock);
+		while (turn != self) {
+			uthread_cond_wait(&turncv, &turnlock);
+		}
+		turn = !self;
+		uthread_cond_signal(&turncv);
+		uthread_mutex_unlock(&turnlock);
+	}
+}
+
+/*
+ * Run two threads of func to completion and report the time taken
+ * for the given number of switches.
+ */
+static
+void
+race(const char *name, void (*func)(void *), unsigned long switches)
+{
+	time_t secs1, secs2;
+	unsigned long nsecs1, nsecs2, usecs;
+	int t0, t1;
+
+	__time(&secs1, &nsecs1);
+
+	t0 = uthread_create(func, (void *)0);
+	t1 = uthread_create(func, (void *)1);
+	if (t0 < 0 || t1 < 0) {
+		err(1, "uthread_create");
+	}
+	if (uthread_join(t0) || uthread_join(t1)) {
+		err(1, "uthread_join");
+	}
+
+	__time(&secs2, &nsecs2);
+
+	if (nsecs2 < nsecs1) {
+		nsecs2 += 1000000000;
+		secs2--;
+	}
+	usecs = (secs2 - secs1) * 1000000 + (nsecs2 - nsecs1) / 1000;
+
+	printf("%s: %lu switches in %lu.%06lu s, %lu ns per switch\n",
+	       name, switches, usecs / 1000000, usecs % 1000000,
+	       (usecs / switches) * 1000 +
+	       (usecs % switches) * 1000 / switches);
+}
+
+int
+main(int argc, char *argv[])
+{
+	rounds = ROUNDS;
+	if (argc > 1) {
+		rounds = atoi(argv[1]);
+	}
+	if (rounds <= 0) {
+		errx(1, "Usage: pingpong [rounds]");
+	}
+
+	/*
+	 * main waits in join, so the two threads only switch between
+	 * each other: once per yield each, and in the cv test once
+	 * per turn.
+	 */
+	race("uthread yield", yielder, 2 * (unsigned long)rounds);
+	race("uthread mutex/cv", player, 2 * (unsigned long)rounds);
+
+	return 0;
+}
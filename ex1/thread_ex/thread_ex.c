@@ -1,4 +1,4 @@
-/* 
+/*
  * CSC 369 Fall 2010 - Excercise 1
  *
  * Zeeshan Qureshi
@@ -6,67 +6,484 @@
  * $Id$
  */
 
+/* Thread creation and barrier release benchmark.
+ *
+ * For each thread count N this measures:
+ *
+ *   create   time to pthread_create one thread that returns at once
+ *   join     time to pthread_join one such thread
+ *   pool     time for N pre-spawned pool workers to each pick up and
+ *            finish an empty task, per task; the baseline to compare
+ *            create + join against
+ *
+ * and the release latency of three barriers, from the moment the last
+ * thread arrives until every one of the N parked threads is running
+ * again, for the slowest thread of each round:
+ *
+ *   pthread  pthread_barrier_wait
+ *   futex    a sense-reversing barrier sleeping on a futex
+ *   condvar  a generation count under a mutex, woken by broadcast
+ *
+ * Every figure is the median over the rounds, in microseconds. With no
+ * thread counts given it sweeps 1, 10, 100, 1000 and 10000.
+ *
+ * Usage: thread_ex [-r rounds] [-c csvfile] [threads ...]
+ */
+
 #include<pthread.h>
 #include<unistd.h>
 #include<stdlib.h>
 #include<stdio.h>
+#include<string.h>
+#include<limits.h>
+#include<time.h>
+#include<sched.h>
+#include<sys/syscall.h>
+#include<linux/futex.h>
+
+/* Stack for every thread, small so 10000 of them fit comfortably */
+#define STACK_SIZE (64 * 1024)
+
+enum { BAR_PTHREAD, BAR_FUTEX, BAR_CONDVAR, NUM_BARRIERS };
+static const char *barrierNames[NUM_BARRIERS] = { "pthread", "futex", "condvar" };
+
+/* Sense-reversing barrier: the last thread to arrive resets the count
+ * and flips the sense, everybody else sleeps on the sense word until
+ * it differs from the sense they arrived with.
+ */
+typedef struct {
+  int count;          /* threads yet to arrive this round */
+  int total;
+  int sense;
+} FutexBarrier;
+
+/* Broadcast barrier: the last thread to arrive bumps the generation */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cv;
+  int count;
+  int total;
+  unsigned long gen;
+} CondBarrier;
 
-/* Initialize mutexx for synchronizing threads */
-pthread_mutex_t threadsCreated;
+/* Pre-spawned pool: each dispatch hands out one empty task per worker */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t work;    /* workers wait here for a dispatch */
+  pthread_cond_t done;    /* main waits here for the last task */
+  unsigned long gen;
+  int size;               /* tasks per dispatch, one per worker */
+  int tasks;              /* tasks not yet picked up */
+  int finished;           /* tasks finished this dispatch */
+  int quit;
+} Pool;
 
-/* Function that each thread runs */
-void *thread_func(void *tid){
-  int id =  (int)tid;
+pthread_attr_t threadAttr;
 
-  printf("Thread %d created\n", id);
+pthread_barrier_t pthreadBarrier;
+FutexBarrier futexBarrier;
+CondBarrier condBarrier;
+Pool pool;
 
-  /* Wait for main program to signal creation of all threads */
-  pthread_mutex_lock(&threadsCreated);
-  printf("Thread %d exiting\n", id);
-  pthread_mutex_unlock(&threadsCreated);
+/* Barrier the workers of the current barrier run park on */
+int barrierKind;
+int barrierRounds;
 
-  pthread_exit(NULL);
+/* Cumulative arrivals and wake-ups over all rounds of a barrier run */
+int arrived;
+int woken;
+
+/* Time each worker came out of the barrier in the current round */
+double *wakeTime;
+
+/* Current time in microseconds */
+static double now(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
 }
 
-int main(int argc, char **argv){
-  /* Check if the argument has been passed or not */
-  if(argc < 2){
-    printf("Not enough arguments!!\n");
-    return -1;
+static void die(const char *what, int rc){
+  fprintf(stderr, "ERROR; %s returned %d (%s)\n", what, rc, strerror(rc));
+  exit(1);
+}
+
+static void startThread(pthread_t *thread, void *(*func)(void *), void *arg){
+  int rc = pthread_create(thread, &threadAttr, func, arg);
+  if(rc)
+    die("pthread_create()", rc);
+}
+
+static void joinThread(pthread_t thread){
+  int rc = pthread_join(thread, NULL);
+  if(rc)
+    die("pthread_join()", rc);
+}
+
+/* Yield until the counter reaches target */
+static void waitFor(int *counter, int target){
+  while(__atomic_load_n(counter, __ATOMIC_ACQUIRE) < target)
+    sched_yield();
+}
+
+static int cmpDouble(const void *a, const void *b){
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double median(double *v, int n){
+  qsort(v, n, sizeof(double), cmpDouble);
+  return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static long futex(int *addr, int op, int val){
+  return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+static void futexBarrierInit(FutexBarrier *b, int total){
+  b->count = total;
+  b->total = total;
+  b->sense = 0;
+}
+
+static void futexBarrierWait(FutexBarrier *b, int *localSense){
+  int sense = !*localSense;
+  *localSense = sense;
+
+  if(__atomic_sub_fetch(&b->count, 1, __ATOMIC_ACQ_REL) == 0){
+    /* Nobody looks at count again until they have seen the new sense */
+    __atomic_store_n(&b->count, b->total, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->sense, sense, __ATOMIC_RELEASE);
+    futex(&b->sense, FUTEX_WAKE_PRIVATE, INT_MAX);
+    return;
+  }
+
+  /* A wake-up before we sleep makes FUTEX_WAIT return at once */
+  while(__atomic_load_n(&b->sense, __ATOMIC_ACQUIRE) != sense)
+    futex(&b->sense, FUTEX_WAIT_PRIVATE, !sense);
+}
+
+static void condBarrierInit(CondBarrier *b, int total){
+  pthread_mutex_init(&b->lock, NULL);
+  pthread_cond_init(&b->cv, NULL);
+  b->count = total;
+  b->total = total;
+  b->gen = 0;
+}
+
+static void condBarrierWait(CondBarrier *b){
+  pthread_mutex_lock(&b->lock);
+  unsigned long gen = b->gen;
+  if(--b->count == 0){
+    b->count = b->total;
+    b->gen++;
+    pthread_cond_broadcast(&b->cv);
+  } else {
+    while(b->gen == gen)
+      pthread_cond_wait(&b->cv, &b->lock);
   }
+  pthread_mutex_unlock(&b->lock);
+}
+
+static void condBarrierDestroy(CondBarrier *b){
+  pthread_cond_destroy(&b->cv);
+  pthread_mutex_destroy(&b->lock);
+}
+
+static void barrierWait(int *localSense){
+  switch(barrierKind){
+  case BAR_PTHREAD:
+    pthread_barrier_wait(&pthreadBarrier);
+    break;
+  case BAR_FUTEX:
+    futexBarrierWait(&futexBarrier, localSense);
+    break;
+  case BAR_CONDVAR:
+    condBarrierWait(&condBarrier);
+    break;
+  }
+}
+
+/* Does nothing; only its creation and join are timed */
+void *emptyThread(void *arg){
+  return NULL;
+}
+
+/* Parks on the barrier once per round and notes when it got out */
+void *barrierThread(void *arg){
+  int id = (int)(long)arg;
+  int localSense = 0;
+
+  for(int r = 0; r < barrierRounds; r++){
+    __atomic_add_fetch(&arrived, 1, __ATOMIC_RELEASE);
+    barrierWait(&localSense);
+    wakeTime[id] = now();
+    __atomic_add_fetch(&woken, 1, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+void *poolThread(void *arg){
+  unsigned long seen = 0;
 
-  /* Parse the command line argument to an int */
-  int numThreads = strtol(argv[1], NULL, 10);
-
-  /* Initialize mutex and print message */
-  pthread_mutex_init(&threadsCreated, NULL);
-  pthread_mutex_lock(&threadsCreated);
-  printf("Main thread: Beginning test\n");
-
-  /* Allocate array for threads and initialize them */
-  pthread_t *threads = malloc(sizeof(pthread_t) * numThreads);
-  for(int  i=0; i<numThreads; i++){
-    int rc = pthread_create(&threads[i], NULL, thread_func, (void *)i);
-    if(rc){
-      printf("ERROR; return code from pthread_create() is %d\n", rc);
-      return -1;
+  pthread_mutex_lock(&pool.lock);
+  for(;;){
+    while(pool.gen == seen && !pool.quit)
+      pthread_cond_wait(&pool.work, &pool.lock);
+    if(pool.quit)
+      break;
+    seen = pool.gen;
+
+    /* Take one task and run it outside the lock; the task itself is
+     * empty, like emptyThread */
+    if(pool.tasks > 0){
+      pool.tasks--;
+      pthread_mutex_unlock(&pool.lock);
+      emptyThread(NULL);
+      pthread_mutex_lock(&pool.lock);
+      if(++pool.finished == pool.size)
+        pthread_cond_signal(&pool.done);
     }
   }
+  pthread_mutex_unlock(&pool.lock);
+  return NULL;
+}
+
+/* Median per-thread create and join time over the rounds */
+static void timeCreateJoin(int n, int rounds, pthread_t *threads,
+                           double *create, double *join){
+  double *c = malloc(sizeof(double) * rounds);
+  double *j = malloc(sizeof(double) * rounds);
+  if(c == NULL || j == NULL){
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+
+  for(int r = 0; r < rounds; r++){
+    double t0 = now();
+    for(int i = 0; i < n; i++)
+      startThread(&threads[i], emptyThread, NULL);
+    double t1 = now();
+    for(int i = 0; i < n; i++)
+      joinThread(threads[i]);
+    double t2 = now();
+
+    c[r] = (t1 - t0) / n;
+    j[r] = (t2 - t1) / n;
+  }
+
+  *create = median(c, rounds);
+  *join = median(j, rounds);
+  free(c);
+  free(j);
+}
+
+/* Median per-task time of a dispatch to n pool workers */
+static double timePool(int n, int rounds, pthread_t *threads){
+  double *t = malloc(sizeof(double) * rounds);
+  if(t == NULL){
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.work, NULL);
+  pthread_cond_init(&pool.done, NULL);
+  pool.size = n;
+  pool.gen = 0;
+  pool.quit = 0;
+  for(int i = 0; i < n; i++)
+    startThread(&threads[i], poolThread, NULL);
+
+  for(int r = 0; r < rounds; r++){
+    double t0 = now();
+    pthread_mutex_lock(&pool.lock);
+    pool.tasks = n;
+    pool.finished = 0;
+    pool.gen++;
+    pthread_cond_broadcast(&pool.work);
+    while(pool.finished < n)
+      pthread_cond_wait(&pool.done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+    t[r] = (now() - t0) / n;
+  }
+
+  pthread_mutex_lock(&pool.lock);
+  pool.quit = 1;
+  pthread_cond_broadcast(&pool.work);
+  pthread_mutex_unlock(&pool.lock);
+  for(int i = 0; i < n; i++)
+    joinThread(threads[i]);
 
-  /* Sleep for some time to allow threads to be created */
-  sleep(5);
+  pthread_cond_destroy(&pool.done);
+  pthread_cond_destroy(&pool.work);
+  pthread_mutex_destroy(&pool.lock);
+
+  double result = median(t, rounds);
+  free(t);
+  return result;
+}
 
-  /* Unlock mutex and wait for threads to join */
-  pthread_mutex_unlock(&threadsCreated);
-  for(int i=0; i<numThreads; i++){
-    pthread_join(threads[i], NULL);
+/* Median release latency of barrier kind with n parked threads; main
+ * is always the last to arrive, so the clock starts as it releases them.
+ */
+static double timeBarrier(int kind, int n, int rounds, pthread_t *threads){
+  double *t = malloc(sizeof(double) * rounds);
+  if(t == NULL){
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
   }
 
-  /* Print final message, free up memory and exit */
-  printf("Main thread: Test complete\n");
+  barrierKind = kind;
+  barrierRounds = rounds;
+  arrived = 0;
+  woken = 0;
+
+  int rc = pthread_barrier_init(&pthreadBarrier, NULL, n + 1);
+  if(rc)
+    die("pthread_barrier_init()", rc);
+  futexBarrierInit(&futexBarrier, n + 1);
+  condBarrierInit(&condBarrier, n + 1);
+
+  for(int i = 0; i < n; i++)
+    startThread(&threads[i], barrierThread, (void *)(long)i);
+
+  int localSense = 0;
+  for(int r = 0; r < rounds; r++){
+    /* Let every worker reach the barrier and go to sleep in it */
+    waitFor(&arrived, n * (r + 1));
+    for(int i = 0; i < 10; i++)
+      sched_yield();
+
+    double t0 = now();
+    barrierWait(&localSense);
+    waitFor(&woken, n * (r + 1));
+
+    double last = t0;
+    for(int i = 0; i < n; i++)
+      if(wakeTime[i] > last)
+        last = wakeTime[i];
+    t[r] = last - t0;
+  }
+
+  for(int i = 0; i < n; i++)
+    joinThread(threads[i]);
+
+  condBarrierDestroy(&condBarrier);
+  pthread_barrier_destroy(&pthreadBarrier);
 
-  pthread_mutex_destroy(&threadsCreated);
-  free(threads);
+  double result = median(t, rounds);
+  free(t);
+  return result;
+}
+
+static void usage(const char *prog){
+  fprintf(stderr, "Usage: %s [-r rounds] [-c csvfile] [threads ...]\n", prog);
+  exit(1);
+}
+
+int main(int argc, char **argv){
+  static int sweep[] = { 1, 10, 100, 1000, 10000 };
+  int rounds = 10;
+  const char *csvName = NULL;
+  int opt;
+
+  while((opt = getopt(argc, argv, "r:c:")) != -1){
+    switch(opt){
+    case 'r':
+      rounds = strtol(optarg, NULL, 10);
+      break;
+    case 'c':
+      csvName = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if(rounds < 1)
+    usage(argv[0]);
+
+  /* Thread counts from the command line, or the default sweep */
+  int numCounts = argc - optind;
+  int *counts = sweep;
+  if(numCounts > 0){
+    counts = malloc(sizeof(int) * numCounts);
+    if(counts == NULL){
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+    }
+    for(int i = 0; i < numCounts; i++){
+      char *end;
+      counts[i] = strtol(argv[optind + i], &end, 10);
+      if(*end != '\0' || counts[i] < 1){
+        fprintf(stderr, "Bad thread count: %s\n", argv[optind + i]);
+        return 1;
+      }
+    }
+  } else {
+    numCounts = sizeof(sweep) / sizeof(sweep[0]);
+  }
+
+  FILE *csv = NULL;
+  if(csvName != NULL){
+    csv = fopen(csvName, "w");
+    if(csv == NULL){
+      perror(csvName);
+      return 1;
+    }
+    fprintf(csv, "threads,create_us,join_us,pool_us");
+    for(int k = 0; k < NUM_BARRIERS; k++)
+      fprintf(csv, ",%s_us", barrierNames[k]);
+    fprintf(csv, "\n");
+  }
+
+  int rc = pthread_attr_init(&threadAttr);
+  if(rc == 0)
+    rc = pthread_attr_setstacksize(&threadAttr, STACK_SIZE);
+  if(rc)
+    die("pthread_attr_setstacksize()", rc);
+
+  printf("%8s %10s %10s %10s", "threads", "create", "join", "pool");
+  for(int k = 0; k < NUM_BARRIERS; k++)
+    printf(" %10s", barrierNames[k]);
+  printf("\n");
+
+  for(int c = 0; c < numCounts; c++){
+    int n = counts[c];
+    pthread_t *threads = malloc(sizeof(pthread_t) * n);
+    wakeTime = malloc(sizeof(double) * n);
+    if(threads == NULL || wakeTime == NULL){
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+    }
+
+    double create, join, release[NUM_BARRIERS];
+    timeCreateJoin(n, rounds, threads, &create, &join);
+    double perTask = timePool(n, rounds, threads);
+    for(int k = 0; k < NUM_BARRIERS; k++)
+      release[k] = timeBarrier(k, n, rounds, threads);
+
+    printf("%8d %10.2f %10.2f %10.2f", n, create, join, perTask);
+    for(int k = 0; k < NUM_BARRIERS; k++)
+      printf(" %10.1f", release[k]);
+    printf("\n");
+    fflush(stdout);
+
+    if(csv != NULL){
+      fprintf(csv, "%d,%.3f,%.3f,%.3f", n, create, join, perTask);
+      for(int k = 0; k < NUM_BARRIERS; k++)
+        fprintf(csv, ",%.3f", release[k]);
+      fprintf(csv, "\n");
+    }
+
+    free(wakeTime);
+    free(threads);
+  }
 
-  pthread_exit(NULL);
+  if(csv != NULL)
+    fclose(csv);
+  pthread_attr_destroy(&threadAttr);
+  if(counts != sweep)
+    free(counts);
+  return 0;
 }
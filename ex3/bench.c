@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "bench.h"
+
+#ifndef DATASIZE
+#define DATASIZE 64
+#endif
+
+#ifndef PAGESIZE
+#define PAGESIZE 4096
+#endif
+
+#define NCOUNTERS 2
+
+/* perf_event_open descriptors, -1 if not open */
+static int counters[NCOUNTERS] = { -1, -1 };
+
+static int
+perf_open(unsigned type, unsigned long long config) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+static void
+perf_init(void) {
+
+    counters[0] = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    counters[1] = perf_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    if(counters[0] < 0 || counters[1] < 0)
+        perror("perf_event_open, not counting cache and dTLB misses");
+}
+
+static void
+perf_start(void) {
+    int i;
+
+    for(i = 0; i < NCOUNTERS; i++) {
+        if(counters[i] >= 0) {
+            ioctl(counters[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static long long
+perf_stop(int i) {
+    long long count;
+
+    if(counters[i] < 0)
+        return (-1);
+    ioctl(counters[i], PERF_EVENT_IOC_DISABLE, 0);
+    if(read(counters[i], &count, sizeof(count)) != sizeof(count))
+        return (-1);
+    return (count);
+}
+
+static void
+perf_close(void) {
+    int i;
+
+    for(i = 0; i < NCOUNTERS; i++) {
+        if(counters[i] >= 0)
+            close(counters[i]);
+        counters[i] = -1;
+    }
+}
+
+static double
+now_ms(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0);
+}
+
+static void
+trial(struct bench *b, void (*workload)(unsigned long), struct bench_trial *t) {
+    struct rusage r0, r1;
+    double t0;
+
+    getrusage(RUSAGE_SELF, &r0);
+    perf_start();
+    t0 = now_ms();
+    workload(b->num_ops);
+    t->ms = now_ms() - t0;
+    t->cache_misses = perf_stop(0);
+    t->dtlb_misses = perf_stop(1);
+    getrusage(RUSAGE_SELF, &r1);
+    t->minflt = r1.ru_minflt - r0.ru_minflt;
+    t->majflt = r1.ru_majflt - r0.ru_majflt;
+}
+
+static int
+cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x < y ? -1 : x > y);
+}
+
+static int
+cmp_llong(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+
+    return (x < y ? -1 : x > y);
+}
+
+/* median of field off (a long long, or a long if lng) over the trials */
+static long long
+median_count(struct bench_trial *t, int n, size_t off, int lng) {
+    long long v[BENCH_MAXTRIALS];
+    int i;
+
+    for(i = 0; i < n; i++) {
+        char *f = (char *)&t[i] + off;
+        v[i] = lng ? *(long *)f : *(long long *)f;
+    }
+    qsort(v, n, sizeof(v[0]), cmp_llong);
+    return (n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2);
+}
+
+void
+bench_run(struct bench *b, void (*workload)(unsigned long num_ops)) {
+    struct bench_trial t[BENCH_MAXTRIALS];
+    double ms[BENCH_MAXTRIALS];
+    double mean = 0, var = 0, median;
+    long long minflt, majflt, cmiss, tmiss;
+    int i, n = b->trials;
+    FILE *fp;
+
+    if(n < 1 || n > BENCH_MAXTRIALS) {
+        fprintf(stderr, "Error: trials must be 1 to %d\n", BENCH_MAXTRIALS);
+        exit(1);
+    }
+    if(b->perf)
+        perf_init();
+
+    for(i = 0; i < b->warmup; i++)
+        workload(b->num_ops);
+    for(i = 0; i < n; i++) {
+        trial(b, workload, &t[i]);
+        ms[i] = t[i].ms;
+        mean += ms[i];
+    }
+    perf_close();
+
+    mean /= n;
+    for(i = 0; i < n; i++)
+        var += (ms[i] - mean) * (ms[i] - mean);
+    var = n > 1 ? var / (n - 1) : 0;
+    qsort(ms, n, sizeof(ms[0]), cmp_double);
+    median = n % 2 ? ms[n / 2] : (ms[n / 2 - 1] + ms[n / 2]) / 2;
+
+    minflt = median_count(t, n, offsetof(struct bench_trial, minflt), 1);
+    majflt = median_count(t, n, offsetof(struct bench_trial, majflt), 1);
+    cmiss = median_count(t, n, offsetof(struct bench_trial, cache_misses), 0);
+    tmiss = median_count(t, n, offsetof(struct bench_trial, dtlb_misses), 0);
+
+    printf("%s %lu ops, %d trials: median %.3f ms, mean %.3f, stddev %.3f, "
+            "min %.3f, max %.3f\n", b->name, b->num_ops, n, median, mean,
+            sqrt(var), ms[0], ms[n - 1]);
+    printf("  median minflt %lld, majflt %lld, cache misses %lld, "
+            "dTLB misses %lld\n", minflt, majflt, cmiss, tmiss);
+
+    if(b->csv == NULL)
+        return;
+    fp = fopen(b->csv, "a");
+    if(fp == NULL) {
+        perror(b->csv);
+        exit(1);
+    }
+    fseek(fp, 0, SEEK_END);
+    if(ftell(fp) == 0)
+        fprintf(fp, "impl,datasize,pagesize,num_ops,warmup,trials,"
+                "median_ms,mean_ms,stddev_ms,min_ms,max_ms,"
+                "minflt,majflt,cache_misses,dtlb_misses\n");
+    fprintf(fp, "%s,%d,%d,%lu,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,"
+            "%lld,%lld,%lld,%lld\n", b->name, DATASIZE, PAGESIZE,
+            b->num_ops, b->warmup, n, median, mean, sqrt(var), ms[0],
+            ms[n - 1], minflt, majflt, cmiss, tmiss);
+    fclose(fp);
+}
@@ -0,0 +1,32 @@
+/* Benchmark harness for the heap drivers.
+ *
+ * A benchmark runs a workload a few times untimed to warm up, then
+ * a number of timed trials, each timed with CLOCK_MONOTONIC and each
+ * taking its page fault counts from getrusage. If the kernel allows it
+ * (see /proc/sys/kernel/perf_event_paranoid, and a virtual machine may
+ * not expose a PMU at all) each trial also counts cache misses and dTLB
+ * load misses with perf_event_open; otherwise those are reported as -1.
+ * The summary goes to stdout and, with a CSV path, is appended to that
+ * file as one row, after a header if the file is new.
+ */
+
+#define BENCH_MAXTRIALS 100
+
+struct bench {
+    const char *name;           // heap implementation
+    unsigned long num_ops;
+    int warmup;
+    int trials;
+    int perf;                   // try to count with perf_event_open
+    const char *csv;            // append a row here, or NULL
+};
+
+struct bench_trial {
+    double ms;
+    long minflt;
+    long majflt;
+    long long cache_misses;     // -1 if not counted
+    long long dtlb_misses;      // -1 if not counted
+};
+
+void bench_run(struct bench *b, void (*workload)(unsigned long num_ops));
@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+
+# Every heap under the benchmark harness, for each DATASIZE and heap
+# size that pageTest.sh tries. Results are appended to ${CSV:-bench.csv};
+# set PERF=-p to count cache and dTLB misses, HUGE=thp to use huge pages.
+
+CSV=${CSV:-bench.csv}
+
+for data_size in 8 16 32 64 128 256
+do
+  export DATASIZE=${data_size}
+  make -s clean
+  make -s -e benchheap benchkheap benchdheap benchbh benchkbh
+
+  for num_ops in 10000 50000 100000 500000
+  do
+    for b in benchheap benchkheap benchdheap benchbh benchkbh
+    do
+      ./${b} -w 1 -r ${TRIALS:-5} ${PERF} -H ${HUGE:-none} -c ${CSV} ${num_ops}
+    done
+  done
+done
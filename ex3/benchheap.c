@@ -0,0 +1,76 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bench.h"
+#include "hugemem.h"
+
+/* The testheap/testbh workload under the benchmark harness. Built once
+ * per heap: with -DBH it drives bheap.c, otherwise whichever heap.h
+ * implementation it is linked with. The program name, less "bench",
+ * names it in the output.
+ */
+#include "workload.h"
+
+static void
+usage(char *prog) {
+
+    printf("Usage: %s [-w warmup] [-r trials] [-p] [-b] [-c csv] "
+            "[-H none|thp|hugetlb] <num_ops>\n", prog);
+    printf("       - num_ops is effectively the size of the heap\n");
+    printf("       - -p counts cache and dTLB misses with perf_event_open\n");
+    printf("       - -b fills with h_build and uses replace_top\n");
+    printf("       - -c appends the results to a CSV file\n");
+    exit(-1);
+}
+
+int main(int argc, char **argv) {
+    struct bench b = { NULL, 0, 1, 5, 0, NULL };
+    char *name, build_name[64];
+    int c;
+
+    name = strrchr(argv[0], '/');
+    name = name != NULL ? name + 1 : argv[0];
+    if (strncmp(name, "bench", 5) == 0 && name[5] != '\0')
+        name += 5;
+    b.name = name;
+
+    while ((c = getopt(argc, argv, "w:r:pbc:H:")) != -1) {
+        switch (c) {
+        case 'w':
+            b.warmup = atoi(optarg);
+            break;
+        case 'r':
+            b.trials = atoi(optarg);
+            break;
+        case 'p':
+            b.perf = 1;
+            break;
+        case 'b':
+            use_build = 1;
+            break;
+        case 'c':
+            b.csv = optarg;
+            break;
+        case 'H':
+            hp_set_mode(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind >= argc)
+        usage(argv[0]);
+    b.num_ops = atol(argv[optind]);
+    if (use_build) {
+        // name the variant in the output and CSV
+        snprintf(build_name, sizeof(build_name), "%s-build", b.name);
+        b.name = build_name;
+    }
+
+    bench_run(&b, workload);
+    return 0;
+}
@@ -4,141 +4,186 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <sys/mman.h>
 
 #include "bheap.h"
+#include "payload.h"
+#include "hugemem.h"
+#include "pagesim.h"
 
-
-static unsigned bh_psize;
-static unsigned bh_shift;
-static unsigned bh_mask;
-static unsigned bh_hshift;
-static unsigned bh_hmask;
-static unsigned bh_half;
-static unsigned bh_len;
-
-struct data **heap;
 int verbose = 0;
 
+#ifdef KEYONLY
+/* key and payload index, see payload.h */
+typedef uint64_t hval_t;
+typedef hval_t elem_t;
+#else
+typedef unsigned hval_t;
+typedef struct data elem_t;
+#endif
+
+/* One B-heap. bh_init and friends work on bh_global; bh_create makes
+ * more, each with its own pages, for users like the MultiQueue that need
+ * several heaps at once.
+ */
+struct bheap {
+    elem_t **heap;          // NULL terminated array of pointers to pages
+    unsigned psize;         // elements in a page
+    unsigned shift;
+    unsigned mask;
+    unsigned hshift;
+    unsigned hmask;
+    unsigned half;
+    unsigned len;
+
+    unsigned pbytes;        // bytes in a page
+    unsigned npages;        // pages allocated
+    unsigned maxpages;      // room in the page table
+    void *spare;            // freed page kept for reuse
+};
+
+static struct bheap bh_global;
+
+#ifdef KEYONLY
+static hval_t getval(struct bheap *bh, int pageno, int index) {
+    PS_TOUCH(&bh->heap[pageno][index], 0);
+    return bh->heap[pageno][index];
+}
 
-int getval(int pageno, int index) {
-    return (heap[pageno][index]).key;
+static void setval(struct bheap *bh, int pageno, int index, hval_t value) {
+    PS_TOUCH(&bh->heap[pageno][index], 1);
+    bh->heap[pageno][index] = value;
+}
+#else
+static hval_t getval(struct bheap *bh, int pageno, int index) {
+    PS_TOUCH(&bh->heap[pageno][index], 0);
+    return (bh->heap[pageno][index]).key;
 }
 
-void setval(int pageno, int index, int value) {
-    heap[pageno][index].key = value;
+static void setval(struct bheap *bh, int pageno, int index, hval_t value) {
+    PS_TOUCH(&bh->heap[pageno][index], 1);
+    bh->heap[pageno][index].key = value;
 }
+#endif
 
 void dump_bh() {
+    struct bheap *bh = &bh_global;
     int page = 0;
     int len = 0;
-    int limit = PAGESIZE / sizeof(struct data);  // must divide evenly
-    while(heap[page] != NULL) {
+    int limit = PAGESIZE / sizeof(elem_t);  // must divide evenly
+    while(bh->heap[page] != NULL) {
         int j = 0;
-        while(j < limit && len <= bh_len) {
+        while(j < limit && len <= bh->len) {
             if(j >= limit-10){
                 printf("%d\n", j);
             };
-            printf("%d ", heap[page][j].key);
+#ifdef KEYONLY
+            printf("%u ", KV_KEY(bh->heap[page][j]));
+#else
+            printf("%d ", bh->heap[page][j].key);
+#endif
             len++;
             j++;
         }
         printf("\n");
         page++;
     }
-    printf("Num pages used = %d, Num elements = %d\n", page, bh_len);
+    printf("Num pages used = %d, Num elements = %d\n", page, bh->len);
 }
 
-static uintptr_t
-bh_rd(unsigned idx) {
+static hval_t
+bh_rd(struct bheap *bh, unsigned idx) {
 
-    assert(idx <= bh_len);
-    return (getval(idx >> bh_shift, idx & bh_mask));
+    assert(idx <= bh->len);
+    return (getval(bh, idx >> bh->shift, idx & bh->mask));
 }
 
 static void
-bh_wr(unsigned idx, uintptr_t val) {
+bh_wr(struct bheap *bh, unsigned idx, hval_t val) {
 
-    assert(idx <= bh_len);
-    setval(idx >> bh_shift, idx & bh_mask, val);
+    assert(idx <= bh->len);
+    setval(bh, idx >> bh->shift, idx & bh->mask, val);
 }
 
 // returns the page offset
 static unsigned
-bh_po(unsigned idx) {
+bh_po(struct bheap *bh, unsigned idx) {
 
-            return (idx & bh_mask);
+            return (idx & bh->mask);
 }
 
 static void
-bh_bubble_up(unsigned idx, unsigned v) {
+bh_bubble_up(struct bheap *bh, unsigned idx, hval_t v) {
 
-    unsigned ip, pv; //ip == index of parent, pv = value of parent
+    unsigned ip;     //ip == index of parent
+    hval_t pv;       //pv == value of parent
     unsigned po;     //po == page offset
 
     while (idx > 1) {
-        po = bh_po(idx);
-        if (idx < bh_psize || po > 3) {
+        po = bh_po(bh, idx);
+        if (idx < bh->psize || po > 3) {
         // we are the top level page or the parent is on
         // the current page
-            ip = (idx & ~bh_mask) | (po >> 1);
+            ip = (idx & ~bh->mask) | (po >> 1);
 
         } else if (po < 2) {
         // if the index is 0 or 1 then we have to move up a page
-            ip = (idx - bh_psize) >> bh_shift;
-            ip += (ip & ~bh_hmask);
-            ip |= bh_psize / 2;
+            ip = (idx - bh->psize) >> bh->shift;
+            ip += (ip & ~bh->hmask);
+            ip |= bh->psize / 2;
         } else {
             ip = idx - 2;
         }
 
-        pv = bh_rd(ip);
+        pv = bh_rd(bh, ip);
         if (pv < v)
             return;
-        bh_wr(ip, v);
-        bh_wr(idx, pv);
+        bh_wr(bh, ip, v);
+        bh_wr(bh, idx, pv);
         idx = ip;
     }
 }
 
-static void 
-bh_bubble_down(unsigned idx, unsigned v) {
+static void
+bh_bubble_down(struct bheap *bh, unsigned idx, hval_t v) {
 
-    unsigned i1, i2, v1, v2;
+    unsigned i1, i2;
+    hval_t v1, v2;
 
-    while (idx < bh_len) {
-        if (idx > bh_mask && !(idx & (bh_mask - 1))) {
+    while (idx < bh->len) {
+        if (idx > bh->mask && !(idx & (bh->mask - 1))) {
                 /* first two elements in nonzero pages */
             i1 = i2 = idx + 2;
-        } else if (idx & (bh_psize >> 1)) {
+        } else if (idx & (bh->psize >> 1)) {
                 /* Last row of page */
-            i1 = (idx & ~bh_mask) >> 1;
-            i1 |= idx & (bh_mask >> 1);
+            i1 = (idx & ~bh->mask) >> 1;
+            i1 |= idx & (bh->mask >> 1);
             i1 += 1;
-            i1 <<= bh_shift;
+            i1 <<= bh->shift;
             i2 = i1 + 1;
         } else {
-            i1 = idx + (idx & bh_mask);
+            i1 = idx + (idx & bh->mask);
             i2 = i1 + 1;
         }
-        if (i1 != i2 && i2 <= bh_len) {
-            v1 = bh_rd(i1);
-            v2 = bh_rd(i2);
+        if (i1 != i2 && i2 <= bh->len) {
+            v1 = bh_rd(bh, i1);
+            v2 = bh_rd(bh, i2);
             if (v1 < v && v1 <= v2) {
-                bh_wr(i1, v);
-                bh_wr(idx, v1);
+                bh_wr(bh, i1, v);
+                bh_wr(bh, idx, v1);
                 idx = i1;
             } else if (v2 < v) {
-                bh_wr(i2, v);
-                bh_wr(idx, v2);
+                bh_wr(bh, i2, v);
+                bh_wr(bh, idx, v2);
                 idx = i2;
             } else {
                 break;
             }
-        } else if (i1 <= bh_len) {
-            v1 = bh_rd(i1);
+        } else if (i1 <= bh->len) {
+            v1 = bh_rd(bh, i1);
             if (v1 < v) {
-                bh_wr(i1, v);
-                bh_wr(idx, v1);
+                bh_wr(bh, i1, v);
+                bh_wr(bh, idx, v1);
                 idx = i1;
             } else {
                 break;
@@ -148,71 +193,305 @@ bh_bubble_down(unsigned idx, unsigned v) {
     }
 }
 
-/* Allocate memory for the heap and set up global variables
- * The number of operations or numtests is effectively the size of the tree.
- * The heap is an array of pointers to pages.
+/* Pages are allocated as len reaches them and freed as it drops back,
+ * so the process's footprint follows the live heap instead of the
+ * largest heap the test will build. Pages that are a multiple of the
+ * system page size are mmap'd one by one so that freeing one really
+ * returns it to the system. One page freed by a remove is kept as a
+ * spare, so a heap that hovers at a page boundary does not map and unmap
+ * the same page on every insert/remove pair. In huge page mode the pages
+ * are carved from 2 MB chunks instead (see hugemem.h), and freed pages
+ * are only recycled.
  */
-void
-bh_init(unsigned psz, unsigned numtests) {
-    unsigned u;
-    unsigned numpages = (numtests * sizeof(struct data))/ psz + 1;
-    if(verbose) {
-        printf("numpages = %d\n", numpages);
-        printf("allcoated %d\n", (numpages + 1) * sizeof(struct data *));
+static void *
+bh_page_alloc(struct bheap *bh) {
+    void *memptr;
+    int r;
+
+    if(bh->spare != NULL) {
+        memptr = bh->spare;
+        bh->spare = NULL;
+        return (memptr);
     }
-    heap = malloc((numpages + 1) * sizeof(struct data *));
-    unsigned i;
-    for(i = 0; i < numpages; i++) {
-        void *memptr;
-		int r;
-        // The -8 on the size should not be necessary, but it seemed that
-        // memallign was allocating 2 pages if psz == _SC_PAGESIZE
-        if((r= posix_memalign(&memptr, sysconf(_SC_PAGESIZE), psz-8)) != 0 ) {
-            fprintf(stderr, "Error: memalign failed %s\n", strerror(r));
+    if(hp_enabled())
+        return (hp_page(bh->pbytes));
+    if(bh->pbytes % sysconf(_SC_PAGESIZE) == 0) {
+        memptr = mmap(NULL, bh->pbytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memptr == MAP_FAILED) {
+            perror("mmap");
+            exit(1);
         }
+    } else if((r = posix_memalign(&memptr, bh->pbytes, bh->pbytes)) != 0) {
+        fprintf(stderr, "Error: memalign failed %s\n", strerror(r));
+        exit(1);
+    }
+    return (memptr);
+}
+
+/* Give a page back for good */
+static void
+bh_page_release(struct bheap *bh, void *page) {
+
+    if(hp_enabled()) {
+        hp_page_free(page);
+    } else if(bh->pbytes % sysconf(_SC_PAGESIZE) == 0) {
+        munmap(page, bh->pbytes);
+    } else {
+        free(page);
+    }
+}
 
-        heap[i] = memptr;
+static void
+bh_page_free(struct bheap *bh, void *page) {
+
+    if(bh->spare == NULL) {
+        bh->spare = page;
+    } else {
+        bh_page_release(bh, page);
+    }
+}
+
+/* Make sure the page holding element idx is allocated */
+static void
+bh_grow(struct bheap *bh, unsigned idx) {
+    unsigned pageno = idx >> bh->shift;
+
+    while(bh->npages <= pageno) {
+        if(bh->npages + 1 >= bh->maxpages) {
+            bh->maxpages *= 2;
+            bh->heap = realloc(bh->heap, bh->maxpages * sizeof(*bh->heap));
+            if(bh->heap == NULL) {
+                fprintf(stderr, "Error: out of memory\n");
+                exit(1);
+            }
+        }
+        bh->heap[bh->npages] = bh_page_alloc(bh);
         if(verbose) {
-            printf("heap[%d] = %x\n", i, (unsigned int)heap[i]);
+            printf("heap[%u] = %p\n", bh->npages,
+                    (void *)bh->heap[bh->npages]);
         }
+        bh->heap[++bh->npages] = NULL;
     }
-    heap[numpages] = NULL;
+}
+
+/* Free the pages past the one holding element idx */
+static void
+bh_shrink(struct bheap *bh, unsigned idx) {
+    unsigned pageno = idx >> bh->shift;
+
+    while(bh->npages > pageno + 1) {
+        bh->npages--;
+        bh_page_free(bh, bh->heap[bh->npages]);
+        bh->heap[bh->npages] = NULL;
+    }
+}
+
+/* Set up an empty heap of psz byte pages */
+static void
+bh_setup(struct bheap *bh, unsigned psz) {
+    unsigned u;
 
-    unsigned numelem = psz / sizeof(struct data);
+    unsigned numelem = psz / sizeof(elem_t);
     /* Calculate the log2(numelem) */
     assert((numelem & (numelem - 1)) == 0);	/* Must be power of two */
     for (u = 1; (1U << u) != numelem; u++)
         ;
-    bh_shift = u;
-    bh_mask = numelem - 1;
+    bh->shift = u;
+    bh->mask = numelem - 1;
+
+    bh->half = numelem / 2;
+    bh->hshift = bh->shift - 1;
+    bh->hmask = bh->mask >> 1;
+
+    bh->len = 0;
+    bh->psize = numelem;
+
+    bh->pbytes = psz;
+    bh->npages = 0;
+    bh->maxpages = 16;
+    bh->spare = NULL;
+    bh->heap = malloc(bh->maxpages * sizeof(*bh->heap));
+    if(bh->heap == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    bh->heap[0] = NULL;
+    bh_grow(bh, 0);
+}
+
+/* Set up global variables for a heap of psz byte pages
+ * The number of operations or numtests is effectively the size of the
+ * tree; it is only used to size the payload pool, the heap's pages are
+ * allocated as it grows.
+ */
+void
+bh_init(unsigned psz, unsigned numtests) {
+
+    bh_setup(&bh_global, psz);
+#ifdef KEYONLY
+    pl_init(numtests);
+#endif
+}
 
-    bh_half = numelem / 2;
-    bh_hshift = bh_shift - 1;
-    bh_hmask = bh_mask >> 1;
+struct bheap *
+bh_create(unsigned psz) {
+    struct bheap *bh = malloc(sizeof(*bh));
 
-    bh_len = 0;
-    bh_psize = numelem;
+    if(bh == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    bh_setup(bh, psz);
+    return (bh);
 }
 
+/* Give back all of bh's pages */
+static void
+bh_teardown(struct bheap *bh) {
+    unsigned i;
+
+    for(i = 0; i < bh->npages; i++)
+        bh_page_release(bh, bh->heap[i]);
+    if(bh->spare != NULL)
+        bh_page_release(bh, bh->spare);
+    free(bh->heap);
+    bh->heap = NULL;
+}
+
+/* Free the heap set up by bh_init */
 void
-bh_insert(unsigned val) {
+bh_finish(void) {
 
-    bh_len++;
-    bh_wr(bh_len, val);
-    bh_bubble_up(bh_len, val);
+    bh_teardown(&bh_global);
+#ifdef KEYONLY
+    pl_finish();
+#endif
+}
+
+void
+bh_destroy(struct bheap *bh) {
+
+    bh_teardown(bh);
+    free(bh);
 }
 
 unsigned
-bh_remove(void) {
+bh_size(struct bheap *bh) {
+    return (bh->len);
+}
 
-    unsigned val, retval;
+unsigned
+bh_top(struct bheap *bh) {
+
+    assert(bh->len > 0);
+#ifdef KEYONLY
+    return (KV_KEY(bh_rd(bh, 1)));
+#else
+    return (bh_rd(bh, 1));
+#endif
+}
+
+void
+bh_push(struct bheap *bh, unsigned val) {
+#ifdef KEYONLY
+    hval_t v = KV_MAKE(val, pl_alloc(val));
+#else
+    hval_t v = val;
+#endif
+
+    bh->len++;
+    bh_grow(bh, bh->len);
+    bh_wr(bh, bh->len, v);
+    bh_bubble_up(bh, bh->len, v);
+}
 
-    retval = bh_rd(1);
-    val = bh_rd(bh_len);
-    bh_len--;
-    if (bh_len == 0)
+unsigned
+bh_pop(struct bheap *bh) {
+
+    hval_t val, top;
+    unsigned retval;
+
+    top = bh_rd(bh, 1);
+#ifdef KEYONLY
+    retval = pl_release(KV_REF(top));
+#else
+    retval = top;
+#endif
+    val = bh_rd(bh, bh->len);
+    bh->len--;
+    bh_shrink(bh, bh->len);
+    if (bh->len == 0)
         return (retval);
-    bh_wr(1, val);
-    bh_bubble_down(1, val);
+    bh_wr(bh, 1, val);
+    bh_bubble_down(bh, 1, val);
+    return (retval);
+}
+
+/* Add n values at once: append them, then sift down every element from
+ * the last up (Floyd's method). A child always has a larger index than
+ * its parent, so going down the indices handles all the children before
+ * their parent, and it works through the heap a page at a time: an
+ * element's sift touches its own page and the pages below it, which were
+ * just visited, so the build walks memory almost sequentially, backwards.
+ */
+void
+bh_heapify(struct bheap *bh, const unsigned *vals, unsigned n) {
+    unsigned i;
+    hval_t v;
+
+    for (i = 0; i < n; i++) {
+#ifdef KEYONLY
+        v = KV_MAKE(vals[i], pl_alloc(vals[i]));
+#else
+        v = vals[i];
+#endif
+        bh->len++;
+        bh_grow(bh, bh->len);
+        bh_wr(bh, bh->len, v);
+    }
+    for (i = bh->len; i >= 1; i--)
+        bh_bubble_down(bh, i, bh_rd(bh, i));
+}
+
+/* Remove the least value and insert val, with a single sift down from
+ * the root instead of a sift down and a sift up
+ */
+unsigned
+bh_replace(struct bheap *bh, unsigned val) {
+    hval_t v, top;
+    unsigned retval;
+
+    assert(bh->len > 0);
+    top = bh_rd(bh, 1);
+#ifdef KEYONLY
+    retval = pl_release(KV_REF(top));
+    v = KV_MAKE(val, pl_alloc(val));
+#else
+    retval = top;
+    v = val;
+#endif
+    bh_wr(bh, 1, v);
+    bh_bubble_down(bh, 1, v);
     return (retval);
 }
+
+void
+bh_build(const unsigned *vals, unsigned n) {
+    bh_heapify(&bh_global, vals, n);
+}
+
+unsigned
+bh_replace_top(unsigned val) {
+    return (bh_replace(&bh_global, val));
+}
+
+void
+bh_insert(unsigned val) {
+    bh_push(&bh_global, val);
+}
+
+unsigned
+bh_remove(void) {
+    return (bh_pop(&bh_global));
+}
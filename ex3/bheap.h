@@ -2,6 +2,20 @@ void bh_init(unsigned psz, unsigned npages);
 void bh_insert(unsigned val);
 unsigned bh_remove(void);
 void dump_bh(void);
+void bh_finish(void);
+void bh_build(const unsigned *vals, unsigned n);
+unsigned bh_replace_top(unsigned val);
+
+/* Separate heaps, for when one is not enough */
+struct bheap;
+struct bheap *bh_create(unsigned psz);
+void bh_destroy(struct bheap *bh);
+void bh_push(struct bheap *bh, unsigned val);
+unsigned bh_pop(struct bheap *bh);
+void bh_heapify(struct bheap *bh, const unsigned *vals, unsigned n);
+unsigned bh_replace(struct bheap *bh, unsigned val);
+unsigned bh_top(struct bheap *bh);
+unsigned bh_size(struct bheap *bh);
 
 // DATASIZE must be a power of 2 - sizeof int so that data will be a power
 // of 2
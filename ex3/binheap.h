@@ -0,0 +1,16 @@
+#include <stdint.h>
+
+
+void VM_init(unsigned ncore, unsigned psize);
+uintptr_t VM_rd(unsigned pgidx, unsigned idx);
+void VM_wr(unsigned pgidx, unsigned idx, uintptr_t val);
+void VM_finish(unsigned *npg, unsigned *npo);
+
+void bh_init(unsigned algo, unsigned psz);
+
+void bh_insert(unsigned val);
+
+unsigned bh_remove(void);
+
+
+
@@ -0,0 +1,236 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "heap.h"
+#include "payload.h"
+#include "hugemem.h"
+#include "pagesim.h"
+
+/* A d-ary heap of key/payload values (see payload.h), DARY children per
+ * node. The children of element i are D*i+1 .. D*i+D, and element i is
+ * stored at heap[i + DARY - 1], which puts every group of children at a
+ * multiple of DARY in the array: with 8 byte values and DARY == 8 each
+ * group is exactly one 64 byte cache line, with DARY == 4 half of one.
+ * A sift down then costs one line per level, and the least child of a
+ * full group is picked with SIMD compares instead of DARY-1 branches.
+ */
+#ifndef DARY
+#define DARY 8
+#endif
+
+#define CACHELINE 64
+
+#if DARY < 2 || (DARY & (DARY - 1)) != 0 || DARY * 8 > CACHELINE
+#error "DARY must be a power of 2 from 2 to 8"
+#endif
+
+typedef uint64_t hval_t;
+
+static unsigned h_len;
+static unsigned long h_size;      // bytes allocated for heap
+static unsigned h_cap;
+
+static hval_t *heap = NULL;
+
+/* array position of element index */
+#define POS(index)  ((index) + DARY - 1)
+
+static hval_t getval(int index) {
+    assert(index < h_len);
+    PS_TOUCH(&heap[POS(index)], 0);
+    return heap[POS(index)];
+}
+
+static void setval(int index, hval_t value) {
+    assert(index < h_len);
+    PS_TOUCH(&heap[POS(index)], 1);
+    heap[POS(index)] = value;
+}
+
+void dump_h() {
+    unsigned int i;
+    for(i = 0; i < h_len; i++) {
+        printf("%u ", KV_KEY(heap[POS(i)]));
+    }
+    printf("\n");
+}
+
+/* Return which of the DARY children starting at c is the least.
+ * c is aligned to DARY * 8 bytes.
+ */
+static inline unsigned
+dh_minchild(const hval_t *c) {
+#if defined(__AVX512F__) && DARY == 8
+    __m512i v = _mm512_load_si512(c);
+    uint64_t m = _mm512_reduce_min_epu64(v);
+
+    return (__builtin_ctz(_mm512_cmpeq_epu64_mask(v, _mm512_set1_epi64(m))));
+#elif defined(__AVX2__) && DARY >= 4
+    /* AVX2 only compares signed 64 bit values, so flip the sign bits */
+    const __m256i flip = _mm256_set1_epi64x(INT64_MIN);
+    __m256i v, v2, ix, i2, gt;
+
+    v = _mm256_xor_si256(_mm256_load_si256((const __m256i *)c), flip);
+    ix = _mm256_setr_epi64x(0, 1, 2, 3);
+#if DARY == 8
+    v2 = _mm256_xor_si256(_mm256_load_si256((const __m256i *)c + 1), flip);
+    gt = _mm256_cmpgt_epi64(v, v2);
+    v = _mm256_blendv_epi8(v, v2, gt);
+    ix = _mm256_blendv_epi8(ix, _mm256_setr_epi64x(4, 5, 6, 7), gt);
+#endif
+    /* lanes 0,1 against 2,3, then lane 0 against 1 */
+    v2 = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2));
+    i2 = _mm256_permute4x64_epi64(ix, _MM_SHUFFLE(1, 0, 3, 2));
+    gt = _mm256_cmpgt_epi64(v, v2);
+    v = _mm256_blendv_epi8(v, v2, gt);
+    ix = _mm256_blendv_epi8(ix, i2, gt);
+
+    v2 = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(2, 3, 0, 1));
+    i2 = _mm256_permute4x64_epi64(ix, _MM_SHUFFLE(2, 3, 0, 1));
+    gt = _mm256_cmpgt_epi64(v, v2);
+    ix = _mm256_blendv_epi8(ix, i2, gt);
+
+    return (_mm256_cvtsi256_si32(ix));
+#else
+    unsigned k, min = 0;
+
+    for (k = 1; k < DARY; k++)
+        if (c[k] < c[min])
+            min = k;
+    return (min);
+#endif
+}
+
+static void
+h_bubble_up(unsigned idx, hval_t v) {
+    unsigned ip;
+    hval_t pv;
+
+    while (idx > 0) {
+        ip = (idx - 1) / DARY;
+
+        pv = getval(ip);
+        if (pv < v)
+            break;
+        setval(idx, pv);
+        idx = ip;
+    }
+    setval(idx, v);
+}
+
+static void
+h_bubble_down(unsigned idx, hval_t v) {
+    unsigned i1, k, n;
+    hval_t v1;
+
+    while ((i1 = idx * DARY + 1) < h_len) {
+        if (i1 + DARY <= h_len) {
+            PS_TOUCH(&heap[POS(i1)], 0);  // the group is on one page
+            k = dh_minchild(&heap[POS(i1)]);
+        } else {
+            /* the last, partly filled group */
+            for (k = 0, n = 1; i1 + n < h_len; n++)
+                if (getval(i1 + n) < getval(i1 + k))
+                    k = n;
+        }
+        v1 = getval(i1 + k);
+        if (v1 >= v)
+            break;
+        setval(idx, v1);
+        idx = i1 + k;
+    }
+    setval(idx, v);
+}
+
+void
+h_init(unsigned ntest) {
+    void *memptr;
+    int r;
+    unsigned long size;
+
+    /* room for the offset and a whole group past the last element */
+    h_cap = ntest;
+    size = (POS(ntest) + DARY) * sizeof(*heap);
+    size = (size + CACHELINE - 1) & ~(unsigned long)(CACHELINE - 1);
+    h_size = size;
+    if(hp_enabled()) {
+        memptr = hp_alloc(size);
+    } else if((r = posix_memalign(&memptr, sysconf(_SC_PAGESIZE), size)) != 0 ) {
+        fprintf(stderr, "Error: memalign failed %s\n", strerror(r)); 
+        exit(1);
+    }
+
+    heap = memptr;
+    h_len = 0;
+    pl_init(ntest);
+}
+
+/* Free the heap */
+void
+h_finish(void) {
+
+    if(hp_enabled())
+        hp_free(heap, h_size);
+    else
+        free(heap);
+    heap = NULL;
+    pl_finish();
+}
+
+void
+h_insert(unsigned val) {
+
+    assert(h_len < h_cap);
+    h_len++;
+    h_bubble_up(h_len - 1, KV_MAKE(val, pl_alloc(val)));
+}
+
+unsigned
+h_remove(void) {
+    hval_t val, top;
+
+    top = getval(0);
+    val = getval(h_len - 1);
+    h_len--;
+    if (h_len > 0)
+        h_bubble_down(0, val);
+    return (pl_release(KV_REF(top)));
+}
+
+/* Add n values at once, then sift down every parent from the last one
+ * up (Floyd's method)
+ */
+void
+h_build(const unsigned *vals, unsigned n) {
+    unsigned i;
+
+    assert(h_len + n <= h_cap);
+    for (i = 0; i < n; i++) {
+        h_len++;
+        setval(h_len - 1, KV_MAKE(vals[i], pl_alloc(vals[i])));
+    }
+    if (h_len < 2)
+        return;
+    for (i = (h_len - 2) / DARY + 1; i-- > 0; )
+        h_bubble_down(i, getval(i));
+}
+
+/* Remove the least value and insert val with one sift down */
+unsigned
+h_replace_top(unsigned val) {
+    hval_t top;
+    unsigned retval;
+
+    assert(h_len > 0);
+    top = getval(0);
+    retval = pl_release(KV_REF(top));
+    h_bubble_down(0, KV_MAKE(val, pl_alloc(val)));
+    return (retval);
+}
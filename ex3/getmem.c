@@ -3,14 +3,42 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
 
 
+/* Return the kB of anonymous memory backed by transparent huge pages,
+ * from /proc/self/smaps_rollup, or 0 if the kernel does not provide it
+ */
+static long hugemem(void) {
+    FILE *fp = fopen("/proc/self/smaps_rollup", "r");
+    char line[256];
+    long kb = 0;
+
+    if(fp == NULL)
+        return 0;
+    while(fgets(line, 256, fp) != NULL) {
+        if(sscanf(line, "AnonHugePages: %ld kB", &kb) == 1)
+            break;
+    }
+    fclose(fp);
+    return kb;
+}
+
 /* Collect current memory stats about the running process that calls getmem 
 * Works by reading /proc/<pid>/stat
 * Fields that we care about are:
 * 10: minflt, 12: majflt, 14: utime, 15: stime, 23: vsize, 24 rss 
+* They are followed by the milliseconds since the first call to getmem
+* and the kB of the process backed by transparent huge pages.
 */
 void getmem() {
+    static struct timespec start;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(start.tv_sec == 0 && start.tv_nsec == 0)
+        start = now;
+
     pid_t pid = getpid();
     char path[128];
     sprintf(path, "/proc/%u/stat", pid);
@@ -51,7 +79,12 @@ void getmem() {
         prev = next;
     }
 
-    printf("%ld %ld %ld %ld %ld %ld\n", minflt, majflt, utime, stime, vsize, rss);
+    fclose(fp);
+
+    double msec = (now.tv_sec - start.tv_sec) * 1000.0 +
+        (now.tv_nsec - start.tv_nsec) / 1000000.0;
+    printf("%ld %ld %ld %ld %ld %ld %.3f %ld\n", minflt, majflt, utime, stime,
+            vsize, rss, msec, hugemem());
 
 }
 /* Main function just to test getmem */
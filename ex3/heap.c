@@ -7,33 +7,65 @@
 #include <sys/queue.h>
 
 #include "heap.h"
+#include "payload.h"
+#include "hugemem.h"
+#include "pagesim.h"
 
 static unsigned h_len;
+static unsigned long h_size;      // bytes allocated for heap
 
-struct data *heap = NULL;
+#ifdef KEYONLY
+/* key and payload index, see payload.h */
+typedef uint64_t hval_t;
 
-int getval(int index) {
+static hval_t *heap = NULL;
+
+static hval_t getval(int index) {
+    assert(index <= h_len);
+    PS_TOUCH(&heap[index], 0);
+    return heap[index];
+}
+
+static void setval(int index, hval_t value) {
+    assert(index <= h_len);
+    PS_TOUCH(&heap[index], 1);
+    heap[index] = value;
+}
+#else
+typedef unsigned hval_t;
+
+static struct data *heap = NULL;
+
+static hval_t getval(int index) {
     assert(index <= h_len);
+    PS_TOUCH(&heap[index], 0);
     return (heap[index]).key;
 }
 
-void setval(int index, int value) {
+static void setval(int index, hval_t value) {
     assert(index <= h_len);
+    PS_TOUCH(&heap[index], 1);
     heap[index].key = value;
 }
+#endif
 
 void dump_h() {
     unsigned int i;
     for(i = 0; i <= h_len; i++) {
+#ifdef KEYONLY
+        printf("%u ", KV_KEY(heap[i]));
+#else
         printf("%d ", heap[i].key);
+#endif
     }
     printf("\n");
 }
 
 
 static void
-h_bubble_up(unsigned idx, unsigned v) {
-    unsigned ip, pv;
+h_bubble_up(unsigned idx, hval_t v) {
+    unsigned ip;
+    hval_t pv;
 
     while (idx > 1) {
         ip = idx / 2;
@@ -48,8 +80,9 @@ h_bubble_up(unsigned idx, unsigned v) {
 }
 
 static void
-h_bubble_down(unsigned idx, unsigned v) {
-    unsigned i1, i2, v1, v2;
+h_bubble_down(unsigned idx, hval_t v) {
+    unsigned i1, i2;
+    hval_t v1, v2;
 
     while (idx < h_len) {
         i1 = idx * 2;
@@ -87,28 +120,59 @@ void
 h_init(unsigned ntest) {
     void *memptr;
     int r;
-    unsigned long size = (ntest + 1) * sizeof(struct data);
-    if((r = posix_memalign(&memptr, sysconf(_SC_PAGESIZE), size)) != 0 ) {
+    unsigned long size = (ntest + 1) * sizeof(*heap);
+    h_size = size;
+    if(hp_enabled()) {
+        memptr = hp_alloc(size);
+    } else if((r = posix_memalign(&memptr, sysconf(_SC_PAGESIZE), size)) != 0 ) {
         fprintf(stderr, "Error: memalign failed %s\n", strerror(r)); 
     }
 
     heap = memptr;
     h_len = 0;
+#ifdef KEYONLY
+    pl_init(ntest);
+#endif
+}
+
+/* Free the heap */
+void
+h_finish(void) {
+
+    if(hp_enabled())
+        hp_free(heap, h_size);
+    else
+        free(heap);
+    heap = NULL;
+#ifdef KEYONLY
+    pl_finish();
+#endif
 }
 
 void
 h_insert(unsigned val) {
+#ifdef KEYONLY
+    hval_t v = KV_MAKE(val, pl_alloc(val));
+#else
+    hval_t v = val;
+#endif
 
     h_len++;
-    setval(h_len, val);
-    h_bubble_up(h_len, val);
+    setval(h_len, v);
+    h_bubble_up(h_len, v);
 }
 
 unsigned
 h_remove(void) {
-    unsigned val, retval;
-
-    retval = getval(1);
+    hval_t val, top;
+    unsigned retval;
+
+    top = getval(1);
+#ifdef KEYONLY
+    retval = pl_release(KV_REF(top));
+#else
+    retval = top;
+#endif
     val = getval(h_len);
     h_len--;
     if (h_len == 0)
@@ -117,3 +181,45 @@ h_remove(void) {
     h_bubble_down(1, val);
     return (retval);
 }
+
+/* Add n values at once: append them all, then sift down every parent
+ * from the last one up (Floyd's method), which costs O(n) against
+ * O(n log n) for n inserts.
+ */
+void
+h_build(const unsigned *vals, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        h_len++;
+#ifdef KEYONLY
+        setval(h_len, KV_MAKE(vals[i], pl_alloc(vals[i])));
+#else
+        setval(h_len, vals[i]);
+#endif
+    }
+    for (i = h_len / 2; i >= 1; i--)
+        h_bubble_down(i, getval(i));
+}
+
+/* Remove the least value and insert val, with a single sift down from
+ * the root instead of a sift down and a sift up
+ */
+unsigned
+h_replace_top(unsigned val) {
+    hval_t v, top;
+    unsigned retval;
+
+    assert(h_len > 0);
+    top = getval(1);
+#ifdef KEYONLY
+    retval = pl_release(KV_REF(top));
+    v = KV_MAKE(val, pl_alloc(val));
+#else
+    retval = top;
+    v = val;
+#endif
+    setval(1, v);
+    h_bubble_down(1, v);
+    return (retval);
+}
@@ -2,6 +2,9 @@ void h_init(unsigned npages);
 void h_insert(unsigned val);
 unsigned h_remove(void);
 void dump_h(void);
+void h_finish(void);
+void h_build(const unsigned *vals, unsigned n);
+unsigned h_replace_top(unsigned val);
 
 // DATASIZE must be a power of 2 - sizeof int so that data will be a power
 // of 2
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "hugemem.h"
+
+static enum hp_mode hp_mode = HP_NONE;
+
+/* chunk that hp_page is carving pages from */
+static char *hp_chunk;
+static size_t hp_left;
+
+/* pages given back by hp_page_free, linked through their first word */
+static void *hp_freelist;
+
+void
+hp_set_mode(const char *name) {
+
+    if(name == NULL || strcmp(name, "none") == 0) {
+        hp_mode = HP_NONE;
+    } else if(strcmp(name, "thp") == 0) {
+        hp_mode = HP_THP;
+    } else if(strcmp(name, "hugetlb") == 0) {
+        hp_mode = HP_HUGETLB;
+    } else {
+        fprintf(stderr, "Error: unknown huge page mode %s\n", name);
+        exit(1);
+    }
+}
+
+int
+hp_enabled(void) {
+    return (hp_mode != HP_NONE);
+}
+
+/* Map size bytes at a 2 MB boundary and ask for transparent huge pages */
+static void *
+hp_thp_alloc(size_t size) {
+    char *p, *start;
+    size_t head, tail;
+
+    p = mmap(NULL, size + HP_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    // trim the mapping down to an aligned range
+    start = (char *)(((uintptr_t)p + HP_SIZE - 1) & ~(HP_SIZE - 1));
+    head = start - p;
+    tail = HP_SIZE - head;
+    if(head > 0)
+        munmap(p, head);
+    if(tail > 0)
+        munmap(start + size, tail);
+
+    if(madvise(start, size, MADV_HUGEPAGE) != 0) {
+        static int warned;
+        if(!warned++)
+            perror("madvise(MADV_HUGEPAGE), using ordinary pages");
+    }
+    return (start);
+}
+
+/* Map at least size bytes, rounded up to whole huge pages */
+void *
+hp_alloc(size_t size) {
+    void *p;
+
+    size = (size + HP_SIZE - 1) & ~(HP_SIZE - 1);
+    if(hp_mode == HP_HUGETLB) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(p != MAP_FAILED)
+            return (p);
+        perror("mmap(MAP_HUGETLB), using transparent huge pages");
+        hp_mode = HP_THP;
+    }
+    return (hp_thp_alloc(size));
+}
+
+/* Unmap memory from hp_alloc */
+void
+hp_free(void *p, size_t size) {
+
+    munmap(p, (size + HP_SIZE - 1) & ~(HP_SIZE - 1));
+}
+
+/* Return a psz byte page, psz a power of two no larger than HP_SIZE.
+ * Pages are carved from huge page chunks, and freed ones are reused but
+ * never unmapped, so a shrinking heap keeps its footprint.
+ */
+void *
+hp_page(size_t psz) {
+    void *page;
+
+    if(hp_freelist != NULL) {
+        page = hp_freelist;
+        hp_freelist = *(void **)page;
+        return (page);
+    }
+    if(hp_left < psz) {
+        hp_chunk = hp_alloc(HP_SIZE);
+        hp_left = HP_SIZE;
+    }
+    page = hp_chunk;
+    hp_chunk += psz;
+    hp_left -= psz;
+    return (page);
+}
+
+void
+hp_page_free(void *page) {
+
+    *(void **)page = hp_freelist;
+    hp_freelist = page;
+}
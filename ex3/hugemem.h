@@ -0,0 +1,23 @@
+/* Huge page backed memory for the heaps.
+ *
+ * The drivers take the mode as an optional argument: "thp" maps the heap
+ * 2 MB aligned and asks for transparent huge pages with
+ * madvise(MADV_HUGEPAGE), "hugetlb" maps it from the reserved 2 MB pages
+ * with MAP_HUGETLB. If the kernel refuses, hugetlb falls back to thp and
+ * thp to ordinary pages, with a warning on stderr. With no mode (or
+ * "none") the heaps allocate memory as before.
+ */
+
+#include <stddef.h>
+
+#define HP_SIZE (2UL * 1024 * 1024)
+
+enum hp_mode { HP_NONE, HP_THP, HP_HUGETLB };
+
+void hp_set_mode(const char *name);
+int hp_enabled(void);
+
+void *hp_alloc(size_t size);
+void hp_free(void *p, size_t size);
+void *hp_page(size_t psz);
+void hp_page_free(void *page);
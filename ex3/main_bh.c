@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <sys/queue.h>
+#include <time.h>
 #include <sys/time.h>
 
 #include "binheap.h"
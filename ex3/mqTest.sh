@@ -0,0 +1,21 @@
+#!/usr/bin/env bash
+
+# Throughput of the MultiQueue against one locked binary heap, 1 to
+# THREADS threads. Each line is: mode threads num_ops ms Mops/s and the
+# percentage of final removes that came out below the previous one.
+
+echo -e "Concurrent Priority Queue Test\n"
+
+make -s testmq
+
+for num_ops in 100000 500000
+do
+  threads=1
+  while [ ${threads} -le ${THREADS:-$(( $(nproc) * 2 ))} ]
+  do
+    ./testmq ${num_ops} ${threads} mq
+    ./testmq ${num_ops} ${threads} lock
+    threads=$(( ${threads} * 2 ))
+  done
+  echo ''
+done
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "bheap.h"
+#include "mqueue.h"
+
+#define CACHELINE 64
+
+struct mq {
+    pthread_mutex_t lock;
+    struct bheap *bh;
+    unsigned top;           // least value in bh, MQ_EMPTY if none
+} __attribute__((aligned(CACHELINE)));
+
+static struct mq *mq;
+static unsigned mq_n;
+
+/* values inserted and not yet claimed by a remove */
+static unsigned mq_count;
+
+/* per-thread random number generator (xorshift) */
+static __thread uint32_t mq_seed;
+
+static unsigned
+mq_random(void) {
+
+    if(mq_seed == 0)
+        mq_seed = (uint32_t)(uintptr_t)&mq_seed | 1;
+    mq_seed ^= mq_seed << 13;
+    mq_seed ^= mq_seed >> 17;
+    mq_seed ^= mq_seed << 5;
+    return (mq_seed % mq_n);
+}
+
+void
+mq_init(unsigned nqueues, unsigned psz) {
+    void *memptr;
+    unsigned i;
+
+    if(posix_memalign(&memptr, CACHELINE, nqueues * sizeof(struct mq)) != 0) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    mq = memptr;
+    mq_n = nqueues;
+    for(i = 0; i < nqueues; i++) {
+        pthread_mutex_init(&mq[i].lock, NULL);
+        mq[i].bh = bh_create(psz);
+        mq[i].top = MQ_EMPTY;
+    }
+    mq_count = 0;
+}
+
+void
+mq_destroy(void) {
+    unsigned i;
+
+    for(i = 0; i < mq_n; i++) {
+        pthread_mutex_destroy(&mq[i].lock);
+        bh_destroy(mq[i].bh);
+    }
+    free(mq);
+}
+
+/* called with q locked, after its heap changed */
+static void
+mq_settop(struct mq *q) {
+    unsigned top = bh_size(q->bh) > 0 ? bh_top(q->bh) : MQ_EMPTY;
+
+    __atomic_store_n(&q->top, top, __ATOMIC_RELAXED);
+}
+
+void
+mq_insert(unsigned val) {
+    struct mq *q;
+
+    for(;;) {
+        q = &mq[mq_random()];
+        if(pthread_mutex_trylock(&q->lock) == 0)
+            break;
+    }
+    bh_push(q->bh, val);
+    mq_settop(q);
+    pthread_mutex_unlock(&q->lock);
+    __atomic_add_fetch(&mq_count, 1, __ATOMIC_RELEASE);
+}
+
+/* Claim one of the inserted values, so that a remove that has claimed
+ * one is sure to find it eventually. Returns 0 if there are none.
+ */
+static int
+mq_claim(void) {
+    unsigned n = __atomic_load_n(&mq_count, __ATOMIC_ACQUIRE);
+
+    while(n > 0) {
+        if(__atomic_compare_exchange_n(&mq_count, &n, n - 1, 0,
+                    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+            return (1);
+    }
+    return (0);
+}
+
+/* Remove a value close to the least, or return MQ_EMPTY */
+unsigned
+mq_remove(void) {
+    struct mq *q, *q2;
+    unsigned val;
+
+    if(!mq_claim())
+        return (MQ_EMPTY);
+    for(;;) {
+        q = &mq[mq_random()];
+        q2 = &mq[mq_random()];
+        if(__atomic_load_n(&q2->top, __ATOMIC_RELAXED) <
+                __atomic_load_n(&q->top, __ATOMIC_RELAXED))
+            q = q2;
+        if(__atomic_load_n(&q->top, __ATOMIC_RELAXED) == MQ_EMPTY)
+            continue;
+        if(pthread_mutex_trylock(&q->lock) != 0)
+            continue;
+        if(bh_size(q->bh) == 0) {
+            pthread_mutex_unlock(&q->lock);
+            continue;
+        }
+        val = bh_pop(q->bh);
+        mq_settop(q);
+        pthread_mutex_unlock(&q->lock);
+        return (val);
+    }
+}
@@ -0,0 +1,17 @@
+/* A relaxed concurrent priority queue (a MultiQueue).
+ *
+ * The queue is a set of B-heaps, each behind its own lock. An insert
+ * puts the value into a random heap. A remove looks at the tops of two
+ * random heaps and takes the smaller one. The result is not always the
+ * true minimum, but it is close to it. Threads rarely meet on a lock,
+ * so throughput scales with the number of threads where a single locked
+ * heap would serialize them. Use a few more heaps than threads (2 per
+ * thread by default). Values must be less than MQ_EMPTY.
+ */
+
+#define MQ_EMPTY ((unsigned)-1)
+
+void mq_init(unsigned nqueues, unsigned psz);
+void mq_destroy(void);
+void mq_insert(unsigned val);
+unsigned mq_remove(void);
@@ -1,6 +1,7 @@
 #!/usr/bin/env bash
 
-echo -e "VM Page Fault Stress Test\n"
+# HUGE=thp or HUGE=hugetlb runs every heap on 2 MB pages
+echo -e "VM Page Fault Stress Test ${HUGE}\n"
 
 for data_size in 8 16 32 64 128 256
 do
@@ -18,11 +19,23 @@ do
       echo -e "DATASIZE: ${data_size}, ${num_ops} ops, run $(( ${i} + 1 )):"
 
       echo 'testheap:'
-      ./testheap ${num_ops}
+      ./testheap ${num_ops} ${HUGE}
+      echo ''
+
+      echo 'testkheap:'
+      ./testkheap ${num_ops} ${HUGE}
+      echo ''
+
+      echo 'testdheap:'
+      ./testdheap ${num_ops} ${HUGE}
       echo ''
 
       echo 'testbh:'
-      ./testbh ${num_ops}
+      ./testbh ${num_ops} ${HUGE}
+      echo ''
+
+      echo 'testkbh:'
+      ./testkbh ${num_ops} ${HUGE}
       echo '----------------------------------------------------------------'
       echo ''
 
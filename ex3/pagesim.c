@@ -0,0 +1,257 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pagesim.h"
+
+/* A resident page. Frames are kept on a doubly linked list in LRU order
+ * (least recent first), and CLOCK sweeps the frame array with a hand.
+ */
+struct frame {
+    unsigned long page;
+    int dirty;
+    int ref;
+    int prev, next;             // LRU list
+    int chain;                  // next frame in the same hash bucket
+};
+
+unsigned ps_shift;
+
+static enum ps_policy ps_policy;
+static unsigned long ps_budget;
+static struct ps_stats ps;
+
+static struct frame *frames;
+static unsigned nframes;        // frames in use
+static unsigned maxframes;      // frames allocated
+static int lru_head, lru_tail;
+static unsigned hand;
+
+/* resident pages, hashed to their frames */
+static int *bucket;
+static unsigned nbuckets;
+
+/* every page ever touched, open addressing, 0 is empty so page + 1 */
+static unsigned long *seen;
+static unsigned long nseen_slots;
+
+static unsigned long
+hash(unsigned long page) {
+    return (page * 0x9E3779B97F4A7C15UL) >> 17;
+}
+
+static void *
+xcalloc(size_t n, size_t size) {
+    void *p = calloc(n, size);
+
+    if(p == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    return (p);
+}
+
+/* record page as touched, return 1 if it was never touched before */
+static int
+mark_seen(unsigned long page) {
+    unsigned long i, j, *old;
+
+    if(2 * (ps.pages + 1) > nseen_slots) {
+        old = seen;
+        j = nseen_slots;
+        nseen_slots = nseen_slots ? 2 * nseen_slots : 1024;
+        seen = xcalloc(nseen_slots, sizeof(*seen));
+        for(i = 0; i < j; i++) {
+            if(old[i] != 0) {
+                unsigned long k = hash(old[i] - 1) & (nseen_slots - 1);
+                while(seen[k] != 0)
+                    k = (k + 1) & (nseen_slots - 1);
+                seen[k] = old[i];
+            }
+        }
+        free(old);
+    }
+    for(i = hash(page) & (nseen_slots - 1); seen[i] != 0;
+            i = (i + 1) & (nseen_slots - 1)) {
+        if(seen[i] == page + 1)
+            return (0);
+    }
+    seen[i] = page + 1;
+    ps.pages++;
+    return (1);
+}
+
+static void
+rehash(void) {
+    unsigned f;
+
+    free(bucket);
+    bucket = xcalloc(nbuckets, sizeof(*bucket));
+    memset(bucket, -1, nbuckets * sizeof(*bucket));
+    for(f = 0; f < nframes; f++) {
+        unsigned b = hash(frames[f].page) & (nbuckets - 1);
+        frames[f].chain = bucket[b];
+        bucket[b] = f;
+    }
+}
+
+static int
+lookup(unsigned long page) {
+    int f;
+
+    for(f = bucket[hash(page) & (nbuckets - 1)]; f != -1; f = frames[f].chain)
+        if(frames[f].page == page)
+            return (f);
+    return (-1);
+}
+
+static void
+unhash(int f) {
+    int *pf = &bucket[hash(frames[f].page) & (nbuckets - 1)];
+
+    while(*pf != f)
+        pf = &frames[*pf].chain;
+    *pf = frames[f].chain;
+}
+
+static void
+lru_remove(int f) {
+
+    if(frames[f].prev != -1)
+        frames[frames[f].prev].next = frames[f].next;
+    else
+        lru_head = frames[f].next;
+    if(frames[f].next != -1)
+        frames[frames[f].next].prev = frames[f].prev;
+    else
+        lru_tail = frames[f].prev;
+}
+
+static void
+lru_append(int f) {
+
+    frames[f].prev = lru_tail;
+    frames[f].next = -1;
+    if(lru_tail != -1)
+        frames[lru_tail].next = f;
+    else
+        lru_head = f;
+    lru_tail = f;
+}
+
+/* pick a frame to evict */
+static int
+victim(void) {
+    int f;
+
+    if(ps_policy == PS_LRU)
+        return (lru_head);
+    for(;;) {
+        f = hand;
+        hand = (hand + 1) % nframes;
+        if(!frames[f].ref)
+            return (f);
+        frames[f].ref = 0;
+    }
+}
+
+void
+ps_init(unsigned long budget, enum ps_policy policy, unsigned psize) {
+    unsigned u;
+
+    assert(budget > 0);
+    assert((psize & (psize - 1)) == 0);	/* Must be power of two */
+    for (u = 0; (1U << u) != psize; u++)
+        ;
+    ps_shift = u;
+    ps_budget = budget;
+    ps_policy = policy;
+    memset(&ps, 0, sizeof(ps));
+
+    nframes = 0;
+    maxframes = 0;
+    frames = NULL;
+    lru_head = lru_tail = -1;
+    hand = 0;
+    nbuckets = 1024;
+    bucket = NULL;
+    rehash();
+    seen = NULL;
+    nseen_slots = 0;
+}
+
+void
+ps_access(unsigned long page, int write) {
+    int f, b;
+
+    ps.accesses++;
+    f = lookup(page);
+    if(f != -1) {
+        if(ps_policy == PS_LRU) {
+            lru_remove(f);
+            lru_append(f);
+        }
+        frames[f].ref = 1;
+        frames[f].dirty |= write;
+        return;
+    }
+
+    ps.pageins++;
+    mark_seen(page);
+    if(nframes < ps_budget) {
+        if(nframes == maxframes) {
+            maxframes = maxframes ? 2 * maxframes : 64;
+            frames = realloc(frames, maxframes * sizeof(*frames));
+            if(frames == NULL) {
+                fprintf(stderr, "Error: out of memory\n");
+                exit(1);
+            }
+        }
+        if(nframes + 1 > 2 * nbuckets) {
+            nbuckets *= 2;
+            rehash();
+        }
+        f = nframes++;
+    } else {
+        f = victim();
+        ps.evictions++;
+        if(frames[f].dirty)
+            ps.pageouts++;
+        unhash(f);
+        if(ps_policy == PS_LRU)
+            lru_remove(f);
+    }
+    frames[f].page = page;
+    frames[f].dirty = write;
+    frames[f].ref = 1;
+    b = hash(page) & (nbuckets - 1);
+    frames[f].chain = bucket[b];
+    bucket[b] = f;
+    if(ps_policy == PS_LRU)
+        lru_append(f);
+}
+
+void
+ps_finish(struct ps_stats *st) {
+
+    if(st != NULL)
+        *st = ps;
+    free(frames);
+    free(bucket);
+    free(seen);
+    frames = NULL;
+    bucket = NULL;
+    seen = NULL;
+}
+
+enum ps_policy
+ps_policy_named(const char *name) {
+
+    if(strcmp(name, "lru") == 0)
+        return (PS_LRU);
+    if(strcmp(name, "clock") == 0)
+        return (PS_CLOCK);
+    fprintf(stderr, "Error: unknown page policy %s\n", name);
+    exit(1);
+}
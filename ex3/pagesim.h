@@ -0,0 +1,40 @@
+/* Page access simulator.
+ *
+ * Counts the page faults a sequence of memory accesses would take with
+ * only a fixed number of pages resident, so that the heaps can be
+ * compared deterministically instead of by squeezing a real machine's
+ * memory. Pages are evicted by LRU or by CLOCK (second chance). A miss
+ * is a page-in. It is cold if the page was never touched before, and
+ * it evicts a page once the budget is full. Evicting a written page is
+ * also a page-out.
+ *
+ * The heaps call PS_TOUCH on every element they read or write from
+ * getval/setval (and so from bh_rd/bh_wr); it only does something in
+ * builds with -DVMSIM. phk's VM_init/VM_rd/VM_wr in vmsim.c use the
+ * same simulator with his page numbers.
+ */
+
+#include <stdint.h>
+
+enum ps_policy { PS_LRU, PS_CLOCK };
+
+struct ps_stats {
+    unsigned long pages;        // distinct pages touched
+    unsigned long accesses;
+    unsigned long pageins;      // all misses, cold ones included
+    unsigned long evictions;    // misses that had to evict a page
+    unsigned long pageouts;     // evicted pages that had been written
+};
+
+void ps_init(unsigned long budget, enum ps_policy policy, unsigned psize);
+void ps_access(unsigned long page, int write);
+void ps_finish(struct ps_stats *st);
+enum ps_policy ps_policy_named(const char *name);
+
+#ifdef VMSIM
+extern unsigned ps_shift;
+#define PS_TOUCH(addr, write) \
+    ps_access((uintptr_t)(addr) >> ps_shift, (write))
+#else
+#define PS_TOUCH(addr, write)
+#endif
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* struct data is the same in heap.h and bheap.h */
+#include "heap.h"
+#include "payload.h"
+#include "hugemem.h"
+#include "pagesim.h"
+
+static struct data *payload;
+static unsigned pl_n;
+
+/* stack of free payload indices */
+static unsigned *pl_free;
+static unsigned pl_nfree;
+
+/* Allocate room for n payloads, all free */
+void
+pl_init(unsigned n) {
+    void *memptr;
+    int r;
+    unsigned i;
+
+    if(hp_enabled()) {
+        memptr = hp_alloc(n * sizeof(struct data));
+    } else if((r = posix_memalign(&memptr, sysconf(_SC_PAGESIZE),
+                    n * sizeof(struct data))) != 0 ) {
+        fprintf(stderr, "Error: memalign failed %s\n", strerror(r));
+        exit(1);
+    }
+    payload = memptr;
+    pl_n = n;
+
+    pl_free = malloc(n * sizeof(unsigned));
+    if(pl_free == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    // push in reverse so payloads are handed out from the bottom up
+    for(i = 0; i < n; i++)
+        pl_free[i] = n - 1 - i;
+    pl_nfree = n;
+}
+
+/* Free the pool */
+void
+pl_finish(void) {
+
+    if(hp_enabled())
+        hp_free(payload, pl_n * sizeof(struct data));
+    else
+        free(payload);
+    free(pl_free);
+}
+
+/* Store key in a free payload and return its index */
+unsigned
+pl_alloc(unsigned key) {
+    unsigned ref;
+
+    if(pl_nfree == 0) {
+        fprintf(stderr, "Error: payload pool is full\n");
+        exit(1);
+    }
+    ref = pl_free[--pl_nfree];
+    PS_TOUCH(&payload[ref], 1);
+    payload[ref].key = key;
+    return (ref);
+}
+
+/* Free payload ref and return the key it held */
+unsigned
+pl_release(unsigned ref) {
+
+    pl_free[pl_nfree++] = ref;
+    PS_TOUCH(&payload[ref], 0);
+    return (payload[ref].key);
+}
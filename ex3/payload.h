@@ -0,0 +1,21 @@
+/* Payload pool for the key-only heap layout (built with -DKEYONLY).
+ *
+ * In the default layout every heap element is a whole struct data, so
+ * each comparison during a sift pulls in a DATASIZE byte slot for a
+ * 4 byte key. In the key-only layout the heap holds just an 8 byte
+ * value per element, the key in the high half and the index of its
+ * payload in the low half, and the payloads sit in this pool and never
+ * move. Comparing two values compares their keys (ties go to the lower
+ * index), so the sift code is unchanged and only touches key lines.
+ */
+
+#include <stdint.h>
+
+#define KV_MAKE(key, ref)   (((uint64_t)(key) << 32) | (ref))
+#define KV_KEY(v)           ((unsigned)((v) >> 32))
+#define KV_REF(v)           ((unsigned)(v))
+
+void pl_init(unsigned n);
+void pl_finish(void);
+unsigned pl_alloc(unsigned key);
+unsigned pl_release(unsigned ref);
@@ -0,0 +1,104 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "pagesim.h"
+
+/* The testheap workload on a simulated VM (pagesim.h): counts the page
+ * faults each heap would take with a given number of resident pages.
+ * Built once per heap from objects compiled with -DVMSIM; with -DBH it
+ * drives bheap.c. The program name, less "sim", names the heap.
+ */
+#include "workload.h"
+
+static struct ps_stats
+simulate(unsigned long ntest, unsigned long budget, enum ps_policy policy,
+        unsigned psize) {
+    struct ps_stats st;
+
+    ps_init(budget, policy, psize);
+    workload(ntest);
+    ps_finish(&st);
+    return (st);
+}
+
+static void
+report(const char *name, const char *policy, unsigned long ntest,
+        unsigned long budget, struct ps_stats *st) {
+
+    printf("%s %s %lu %lu %lu %lu %lu %lu %lu\n", name, policy, ntest, budget,
+            st->pages, st->accesses, st->pageins, st->evictions,
+            st->pageouts);
+}
+
+static void
+usage(char *prog) {
+
+    printf("Usage: %s [-p lru|clock] [-m pages] [-P page size] [-b] "
+            "<num_ops>\n", prog);
+    printf("       - num_ops is effectively the size of the heap\n");
+    printf("       - -m runs with that many resident pages; without it\n");
+    printf("         the budget goes from all the pages used down by\n");
+    printf("         halves to one\n");
+    printf("       - -b fills with h_build and uses replace_top\n");
+    printf("Prints: heap policy num_ops budget pages accesses pageins "
+            "evictions pageouts\n");
+    exit(-1);
+}
+
+int main(int argc, char **argv) {
+    const char *policy = "lru";
+    unsigned long budget = 0, num_ops;
+    unsigned psize = PAGESIZE;
+    struct ps_stats st;
+    char *name, build_name[64];
+    int c;
+
+    name = strrchr(argv[0], '/');
+    name = name != NULL ? name + 1 : argv[0];
+    if (strncmp(name, "sim", 3) == 0 && name[3] != '\0')
+        name += 3;
+
+    while ((c = getopt(argc, argv, "p:m:P:b")) != -1) {
+        switch (c) {
+        case 'p':
+            policy = optarg;
+            break;
+        case 'm':
+            budget = strtoul(optarg, NULL, 0);
+            break;
+        case 'P':
+            psize = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            use_build = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind >= argc)
+        usage(argv[0]);
+    num_ops = atol(argv[optind]);
+    if (use_build) {
+        snprintf(build_name, sizeof(build_name), "%s-build", name);
+        name = build_name;
+    }
+
+    if (budget > 0) {
+        st = simulate(num_ops, budget, ps_policy_named(policy), psize);
+        report(name, policy, num_ops, budget, &st);
+        return 0;
+    }
+
+    // find how many pages the heap uses, then shrink the budget
+    st = simulate(num_ops, -1, ps_policy_named(policy), psize);
+    for (budget = st.pages; budget >= 1; budget /= 2) {
+        st = simulate(num_ops, budget, ps_policy_named(policy), psize);
+        report(name, policy, num_ops, budget, &st);
+    }
+    return 0;
+}
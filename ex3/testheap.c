@@ -6,6 +6,7 @@
 #include <sys/time.h>
 
 #include "heap.h"
+#include "hugemem.h"
 
 void getmem(void);
 
@@ -18,6 +19,7 @@ h_test(unsigned ntest) {
     for (u = 0; u < ntest; u++)
         h_insert(random() % 10000);
 	//dump_h();
+    getmem();
     for (u = 0; u < ntest; u++) {
         h_remove();
         h_insert(random() % 10000);
@@ -35,11 +37,14 @@ int main(int argc, char **argv) {
     //time_t start;
 
     if (argc < 2) {
-        printf("Usage: %s <num_ops>\n", argv[0]);
+        printf("Usage: %s <num_ops> [none|thp|hugetlb]\n", argv[0]);
         printf("       - num_ops is effectively the size of the heap\n");
+        printf("       - thp or hugetlb backs the heap with 2 MB pages\n");
         exit(-1);
     }
     unsigned long num_ops = atol(argv[1]);
+    if (argc > 2)
+        hp_set_mode(argv[2]);
     h_test(num_ops);
 
     //printf("Pagesize = %d\n", PAGESIZE);
@@ -0,0 +1,158 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "heap.h"
+#include "mqueue.h"
+
+/* Concurrent priority queue benchmark: the MultiQueue against one
+ * binary heap behind a mutex. Every thread inserts its share of num_ops
+ * values, then removes and inserts that many times, then removes its
+ * share again, with a barrier between the phases.
+ */
+
+enum { MODE_MQ, MODE_LOCK };
+
+static int mode;
+static unsigned nthreads;
+static unsigned share;
+
+static pthread_mutex_t h_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_barrier_t phase;
+
+struct worker {
+    pthread_t tid;
+    unsigned seed;
+    unsigned long long sum_in;
+    unsigned long long sum_out;
+    unsigned inversions;        // removes below the previous, in phase 3
+} __attribute__((aligned(64)));
+
+static void
+q_insert(unsigned val) {
+
+    if(mode == MODE_MQ) {
+        mq_insert(val);
+    } else {
+        pthread_mutex_lock(&h_lock);
+        h_insert(val);
+        pthread_mutex_unlock(&h_lock);
+    }
+}
+
+static unsigned
+q_remove(void) {
+    unsigned val;
+
+    if(mode == MODE_MQ)
+        return (mq_remove());
+    pthread_mutex_lock(&h_lock);
+    val = h_remove();
+    pthread_mutex_unlock(&h_lock);
+    return (val);
+}
+
+static void *
+work(void *arg) {
+    struct worker *w = arg;
+    unsigned u, val, last;
+
+    for (u = 0; u < share; u++) {
+        val = rand_r(&w->seed) % 10000;
+        w->sum_in += val;
+        q_insert(val);
+    }
+    pthread_barrier_wait(&phase);
+    for (u = 0; u < share; u++) {
+        w->sum_out += q_remove();
+        val = rand_r(&w->seed) % 10000;
+        w->sum_in += val;
+        q_insert(val);
+    }
+    pthread_barrier_wait(&phase);
+    last = 0;
+    for (u = 0; u < share; u++) {
+        val = q_remove();
+        assert(val != MQ_EMPTY);
+        if (val < last)
+            w->inversions++;
+        last = val;
+        w->sum_out += val;
+    }
+    return (NULL);
+}
+
+int main(int argc, char **argv) {
+    struct timespec t0, t1;
+    struct worker *w;
+    unsigned long long sum_in = 0, sum_out = 0;
+    unsigned inversions = 0, qper = 2, i;
+    double ms;
+
+    if (argc < 3) {
+        printf("Usage: %s <num_ops> <threads> [mq|lock] [queues per thread]\n",
+                argv[0]);
+        printf("       - num_ops is effectively the size of the heap\n");
+        printf("       - lock runs one binary heap behind a mutex\n");
+        exit(-1);
+    }
+    unsigned long num_ops = atol(argv[1]);
+    nthreads = atoi(argv[2]);
+    mode = (argc > 3 && strcmp(argv[3], "lock") == 0) ? MODE_LOCK : MODE_MQ;
+    if (argc > 4)
+        qper = atoi(argv[4]);
+    if (nthreads == 0 || qper == 0) {
+        fprintf(stderr, "Error: need at least one thread and queue\n");
+        exit(1);
+    }
+    if (num_ops < nthreads) {
+        fprintf(stderr, "Error: need at least one op per thread\n");
+        exit(1);
+    }
+    // num_ops is rounded down to a whole share per thread
+    share = num_ops / nthreads;
+    num_ops = (unsigned long)share * nthreads;
+
+    if (mode == MODE_MQ)
+        mq_init(qper * nthreads, PAGESIZE);
+    else
+        h_init(num_ops);
+    pthread_barrier_init(&phase, NULL, nthreads);
+    w = calloc(nthreads, sizeof(*w));
+    if (w == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < nthreads; i++) {
+        w[i].seed = i + 1;
+        pthread_create(&w[i].tid, NULL, work, &w[i]);
+    }
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(w[i].tid, NULL);
+        sum_in += w[i].sum_in;
+        sum_out += w[i].sum_out;
+        inversions += w[i].inversions;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    // every value that went in must have come out
+    assert(sum_in == sum_out);
+
+    ms = (t1.tv_sec - t0.tv_sec) * 1000.0 +
+        (t1.tv_nsec - t0.tv_nsec) / 1000000.0;
+    printf("%s %u %lu %.3f %.3f %.2f\n", mode == MODE_MQ ? "mq" : "lock",
+            nthreads, num_ops, ms, 4.0 * num_ops / ms / 1000,
+            100.0 * inversions / num_ops);
+
+    pthread_barrier_destroy(&phase);
+    if (mode == MODE_MQ)
+        mq_destroy();
+    free(w);
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "binheap.h"
+#include "pagesim.h"
+
+/**********************************************************************
+ * A simple minded  Virtual Memory Simulator
+ *
+ * phk's interface, on top of pagesim.c: the pages' contents are kept
+ * here, pagesim decides which are resident. $VM_POLICY picks lru (the
+ * default, as in the original) or clock.
+ */
+
+static unsigned 		vm_psize;
+static uintptr_t		*vm_pidx[10000];
+
+void
+VM_init(unsigned ncore, unsigned psize)
+{
+	const char *policy = getenv("VM_POLICY");
+
+	vm_psize = psize;
+	memset(vm_pidx, 0, sizeof vm_pidx);
+	ps_init(ncore, policy != NULL ? ps_policy_named(policy) : PS_LRU, 1);
+}
+
+static uintptr_t *
+VM_getp(unsigned pgidx, int write)
+{
+	uintptr_t *p;
+
+	assert(pgidx < sizeof vm_pidx / sizeof vm_pidx[0]);
+	p = vm_pidx[pgidx];
+	if (p == NULL) {
+		p = calloc(sizeof(uintptr_t), vm_psize);
+		assert(p != NULL);
+		vm_pidx[pgidx] = p;
+	}
+	ps_access(pgidx, write);
+	return (p);
+}
+
+uintptr_t
+VM_rd(unsigned pgidx, unsigned idx)
+{
+
+	assert(idx < vm_psize);
+	return (VM_getp(pgidx, 0)[idx]);
+}
+
+void
+VM_wr(unsigned pgidx, unsigned idx, uintptr_t val)
+{
+
+	assert(idx < vm_psize);
+	VM_getp(pgidx, 1)[idx] = val;
+}
+
+/* Pages used, and page operations: page-ins that had to evict a page,
+ * plus page-outs of written pages
+ */
+void
+VM_finish(unsigned *npg, unsigned *npo)
+{
+	struct ps_stats st;
+	unsigned u;
+
+	ps_finish(&st);
+	*npg = st.pages;
+	*npo = st.evictions + st.pageouts;
+	for (u = 0; u < sizeof vm_pidx / sizeof vm_pidx[0]; u++)
+		free(vm_pidx[u]);
+}
@@ -0,0 +1,63 @@
+/* The heap workload shared by simtest.c and benchheap.c: fill a heap of
+ * ntest values, remove and insert ntest times, then drain it, checking
+ * the order. Include it once per program; with -DBH it drives
+ * bheap.c, otherwise whichever heap.h implementation the program is
+ * linked with.
+ */
+#include <assert.h>
+#include <stdlib.h>
+
+#ifdef BH
+#include "bheap.h"
+#define Q_INIT(n)   bh_init(PAGESIZE, (n))
+#define Q_INSERT    bh_insert
+#define Q_REMOVE    bh_remove
+#define Q_FINISH    bh_finish
+#define Q_BUILD     bh_build
+#define Q_REPLACE   bh_replace_top
+#else
+#include "heap.h"
+#define Q_INIT(n)   h_init(n)
+#define Q_INSERT    h_insert
+#define Q_REMOVE    h_remove
+#define Q_FINISH    h_finish
+#define Q_BUILD     h_build
+#define Q_REPLACE   h_replace_top
+#endif
+
+/* fill the heap with one build and replace its top, instead of
+ * inserting and removing one at a time */
+static int use_build;
+
+static void
+workload(unsigned long ntest) {
+    unsigned long u;
+    unsigned ux, ul, *vals;
+
+    srandom(0);
+    Q_INIT(ntest);
+    if (use_build) {
+        vals = malloc(ntest * sizeof(*vals));
+        assert(vals != NULL);
+        for (u = 0; u < ntest; u++)
+            vals[u] = random() % 10000;
+        Q_BUILD(vals, ntest);
+        free(vals);
+        for (u = 0; u < ntest; u++)
+            Q_REPLACE(random() % 10000);
+    } else {
+        for (u = 0; u < ntest; u++)
+            Q_INSERT(random() % 10000);
+        for (u = 0; u < ntest; u++) {
+            Q_REMOVE();
+            Q_INSERT(random() % 10000);
+        }
+    }
+    ul = 0;
+    for (u = 0; u < ntest; u++) {
+        ux = Q_REMOVE();
+        assert(ul <= ux);
+        ul = ux;
+    }
+    Q_FINISH();
+}